@@ -0,0 +1,193 @@
+#include <iostream>
+#include <utility>
+#include <type_traits>
+#include <tuple>
+#include <vector>
+#include <variant>
+#include <array>
+#include <cstdint>
+#include <chrono>
+#include <random>
+
+// create_variant_vec (building_graph.cpp) gives us a std::vector<std::variant<Ts...>>, and we walk it with
+// std::visit. Two costs:
+//   - a type switch per element (the branch predictor guesses the type of every element),
+//   - every slot is as big as the biggest alternative (+ the index, + padding).
+//
+// bucketed_vector<Ts...> keeps one std::vector per type. visit(f) walks bucket by bucket: inside a bucket
+// the type is fixed, so the loop has no switch at all and the compiler can vectorize f.
+// If the global insertion order matters, bucketed_vector<ordered<Ts...>> also records (type, index)
+// per element, and visit_in_order(f) replays it through a table of function pointers.
+
+template <typename... Ts>
+struct ordered {};
+
+
+namespace detail
+{
+    template <typename T, typename... Ts>
+    struct index_of : std::integral_constant<std::size_t, 0> {};
+
+    template <typename T, typename F, typename... Ts>
+    struct index_of<T, F, Ts...>
+        : std::integral_constant<std::size_t, std::is_same_v<T, F> ? 0 : 1 + index_of<T, Ts...>::value> {};
+
+    template <typename T, typename... Ts>
+    constexpr bool type_exists_v = (std::is_same_v<T, Ts> || ...);
+}
+
+
+template <bool keep_order, typename... Ts>
+class bucketed_vector_base
+{
+    static_assert(sizeof...(Ts) <= 256, "the order log keeps the type in one byte");
+
+public:
+    template <typename T>
+    static constexpr std::size_t index_v = detail::index_of<T, Ts...>::value;
+
+    template <typename T, typename... Args>
+    T& emplace_back(Args&&... args)
+    {
+        static_assert(detail::type_exists_v<T, Ts...>, "not one of the alternatives");
+        auto& b = bucket<T>();
+        if constexpr (keep_order)
+        {
+            order.push_back({static_cast<std::uint8_t>(index_v<T>), static_cast<std::uint32_t>(b.size())});
+        }
+        return b.emplace_back(std::forward<Args>(args)...);
+    }
+
+    template <typename T>
+    void push_back(T&& t) { emplace_back<std::decay_t<T>>(std::forward<T>(t)); }
+
+    template <typename T>
+    std::vector<T>& bucket() { return std::get<std::vector<T>>(buckets); }
+
+    template <typename T>
+    std::vector<T> const& bucket() const { return std::get<std::vector<T>>(buckets); }
+
+    std::size_t size() const { return std::apply([](auto const&... b) { return (b.size() + ... + 0); }, buckets); }
+
+    void clear()
+    {
+        std::apply([](auto&... b) { (b.clear(), ...); }, buckets);
+        if constexpr (keep_order) { order.clear(); }
+    }
+
+    // Type batched: all the Ts[0], then all the Ts[1], ...
+    template <typename F>
+    void visit(F&& f)
+    {
+        std::apply([&](auto&... b) { (visit_bucket(b, f), ...); }, buckets);
+    }
+
+    // Only the types you care about, the other buckets are not even touched.
+    template <typename... Us, typename F>
+    void visit_only(F&& f)
+    {
+        (visit_bucket(bucket<Us>(), f), ...);
+    }
+
+    template <typename F>
+    void visit_in_order(F&& f)
+    {
+        static_assert(keep_order, "use bucketed_vector<ordered<Ts...>> to keep the insertion order");
+        using fn_t = void (*)(bucketed_vector_base&, std::uint32_t, F&);
+        // one entry per type, the same idea as std::visit, but we build it once.
+        static constexpr fn_t table[] = {&call_at<Ts, F>...};
+        for (auto const& e: order) { table[e.type](*this, e.index, f); }
+    }
+
+private:
+    template <typename B, typename F>
+    static void visit_bucket(B& b, F& f)
+    {
+        for (auto& x: b) { f(x); }
+    }
+
+    template <typename T, typename F>
+    static void call_at(bucketed_vector_base& self, std::uint32_t i, F& f) { f(self.bucket<T>()[i]); }
+
+    struct entry
+    {
+        std::uint8_t type;
+        std::uint32_t index;
+    };
+
+    std::tuple<std::vector<Ts>...> buckets;
+    std::conditional_t<keep_order, std::vector<entry>, std::tuple<>> order;
+};
+
+
+template <typename... Ts>
+class bucketed_vector : public bucketed_vector_base<false, Ts...> {};
+
+template <typename... Ts>
+class bucketed_vector<ordered<Ts...>> : public bucketed_vector_base<true, Ts...> {};
+
+
+// Events of very different sizes: in a variant, every Tick would pay for a Quote's size.
+struct Tick  { int price; };
+struct Trade { int price; int qty; };
+struct Quote { int bid[4]; int ask[4]; };
+
+std::ostream& operator<<(std::ostream& os, Tick const& t)  { return os << "Tick(" << t.price << ")"; }
+std::ostream& operator<<(std::ostream& os, Trade const& t) { return os << "Trade(" << t.price << "x" << t.qty << ")"; }
+std::ostream& operator<<(std::ostream& os, Quote const& q) { return os << "Quote(" << q.bid[0] << "/" << q.ask[0] << ")"; }
+
+long value(Tick const& t)  { return t.price; }
+long value(Trade const& t) { return static_cast<long>(t.price) * t.qty; }
+long value(Quote const& q) { return q.ask[0] - q.bid[0]; }
+
+
+int main()
+{
+    bucketed_vector<ordered<Tick, Trade, Quote>> events;
+    events.push_back(Tick{10});
+    events.push_back(Trade{11, 5});
+    events.push_back(Tick{12});
+    events.push_back(Quote{{9, 8, 7, 6}, {13, 14, 15, 16}});
+
+    events.visit([](auto const& e) { std::cout << e << ' '; });           // Tick(10) Tick(12) Trade(11x5) Quote(9/13)
+    std::cout << '\n';
+    events.visit_in_order([](auto const& e) { std::cout << e << ' '; });  // Tick(10) Trade(11x5) Tick(12) Quote(9/13)
+    std::cout << '\n';
+    events.visit_only<Trade>([](Trade const& t) { std::cout << t << '\n'; });
+
+    // memory per element: a Tick in a variant takes the size of a Quote.
+    std::cout << "variant slot: " << sizeof(std::variant<Tick, Trade, Quote>) << " bytes, Tick: " << sizeof(Tick) << " bytes\n";
+
+    // A quick comparison with vector<variant> + std::visit, on a random mix of events.
+    constexpr std::size_t n = 3'000'000;
+    std::vector<std::variant<Tick, Trade, Quote>> var_vec;
+    bucketed_vector<Tick, Trade, Quote> buckets;
+    var_vec.reserve(n);
+
+    std::mt19937 gen{42};
+    std::uniform_int_distribution<int> pick{0, 2};
+    for (std::size_t i{0}; i < n; ++i)
+    {
+        int const p = static_cast<int>(i % 100);
+        switch (pick(gen))
+        {
+            case 0:  var_vec.emplace_back(Tick{p});                               buckets.push_back(Tick{p}); break;
+            case 1:  var_vec.emplace_back(Trade{p, 2});                           buckets.push_back(Trade{p, 2}); break;
+            default: var_vec.emplace_back(Quote{{p, 0, 0, 0}, {p + 1, 0, 0, 0}}); buckets.push_back(Quote{{p, 0, 0, 0}, {p + 1, 0, 0, 0}}); break;
+        }
+    }
+
+    auto time = [](auto f)
+    {
+        auto start = std::chrono::steady_clock::now();
+        long r = f();
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+        return std::pair{r, us};
+    };
+
+    auto [r1, t1] = time([&]() { long s{0}; for (auto const& v: var_vec) { s += std::visit([](auto const& e) { return value(e); }, v); } return s; });
+    auto [r2, t2] = time([&]() { long s{0}; buckets.visit([&](auto const& e) { s += value(e); }); return s; });
+
+    std::cout << "vector<variant>: " << r1 << " in " << t1 << "us\n";
+    std::cout << "bucketed_vector: " << r2 << " in " << t2 << "us\n";
+}
@@ -0,0 +1,252 @@
+#include <iostream>
+#include <utility>
+#include <type_traits>
+#include <vector>
+#include <tuple>
+#include <variant>
+#include <array>
+#include <new>
+#include <cstddef>
+#include <cstdint>
+
+// In building_graph.cpp, VarVectorBuilder keeps its stages in a std::vector<std::variant<Ts...>>:
+//   - a push_back may reallocate, and then every stage moves (no stable address),
+//   - every slot is as big as the biggest stage,
+//   - a rebuild frees and reallocates the vector.
+//
+// Here the builder takes a storage policy. vector_storage is the old behavior; arena_storage places
+// each stage in a monotonic arena, at most once per type (a stage is created once), so:
+//   - the arena size is known at compile time, and it lives inline: no heap allocation at all,
+//   - a stage never moves once created,
+//   - reset() rewinds the arena in one step (it only runs destructors for the types that need one, in reverse
+//     creation order, like the vector).
+
+struct C1;
+struct B1;
+struct B2;
+struct A1;
+
+struct A1
+{
+   using depends_on = std::tuple<>;
+   friend std::ostream& operator<<(std::ostream& os, A1 const&) { return os << "A1"; }
+};
+
+struct B1
+{
+   using depends_on = std::tuple<A1, B2>;
+   friend std::ostream& operator<<(std::ostream& os, B1 const&) { return os << "B1"; }
+};
+
+struct B2
+{
+   using depends_on = std::tuple<A1>;
+   friend std::ostream& operator<<(std::ostream& os, B2 const&) { return os << "B2"; }
+};
+
+struct C1
+{
+   using depends_on = std::tuple<B1, B2>;
+   friend std::ostream& operator<<(std::ostream& os, C1 const&) { return os << "C1"; }
+   std::vector<int> results{1, 2, 3};  // not trivially destructible, on purpose.
+};
+
+
+namespace detail
+{
+    template <typename T, typename... Ts>
+    struct index_of : std::integral_constant<std::size_t, 0> {};
+
+    template <typename T, typename F, typename... Ts>
+    struct index_of<T, F, Ts...>
+        : std::integral_constant<std::size_t, std::is_same_v<T, F> ? 0 : 1 + index_of<T, Ts...>::value> {};
+
+    constexpr std::size_t align_up(std::size_t n, std::size_t a) { return (n + a - 1) / a * a; }
+}
+
+
+// The old storage: a vector of variants, searched linearly.
+template <typename... Ts>
+class vector_storage
+{
+public:
+    template <typename T>
+    bool has() const { return find<T>() != nullptr; }
+
+    template <typename T>
+    T& emplace() { vec.push_back(T{}); return std::get<T>(vec.back()); }
+
+    template <typename T>
+    T& get() { return *find<T>(); }
+
+    template <typename F>
+    void for_each(F f) { for (auto& v: vec) { std::visit(f, v); } }
+
+    void reset() { vec.clear(); }
+
+private:
+    template <typename T>
+    T* find() const
+    {
+        for (auto& v: vec)
+        {
+            if (auto p = std::get_if<T>(&v)) { return const_cast<T*>(p); }
+        }
+        return nullptr;
+    }
+
+    std::vector<std::variant<Ts...>> vec;
+};
+
+
+// One slot per type in a monotonic buffer. The buffer is sized for the worst case (every type created),
+// so the bump pointer can never run out.
+template <typename... Ts>
+class arena_storage
+{
+public:
+    static constexpr std::size_t N = sizeof...(Ts);
+    static_assert(N <= 256, "the creation order keeps the type in one byte");
+    static constexpr std::size_t capacity = (detail::align_up(sizeof(Ts), alignof(Ts)) + ... + 0)
+                                          + (alignof(Ts) + ... + 0);
+
+    arena_storage() = default;
+    arena_storage(arena_storage const&) = delete;
+    arena_storage& operator=(arena_storage const&) = delete;
+    ~arena_storage() { reset(); }
+
+    template <typename T>
+    static constexpr std::size_t slot_v = detail::index_of<T, Ts...>::value;
+
+    template <typename T>
+    bool has() const { return slots[slot_v<T>] != nullptr; }
+
+    // A type is placed at most once (the capacity counts one slot per type): a second emplace<T> returns the
+    // stage already there.
+    template <typename T>
+    T& emplace()
+    {
+        if (has<T>()) { return get<T>(); }
+
+        // bump allocation: align the top, place the stage, move the top.
+        std::size_t const offset = detail::align_up(top, alignof(T));
+        T* p = ::new (static_cast<void*>(buffer + offset)) T{};
+        top = offset + sizeof(T);
+
+        slots[slot_v<T>] = p;
+        order[count++] = static_cast<std::uint8_t>(slot_v<T>);
+        return *p;
+    }
+
+    template <typename T>
+    T& get() { return *static_cast<T*>(slots[slot_v<T>]); }
+
+    // in creation order, like the vector.
+    template <typename F>
+    void for_each(F f)
+    {
+        for (std::size_t k{0}; k < count; ++k) { visit_slot(order[k], f, std::index_sequence_for<Ts...>{}); }
+    }
+
+    // Nothing is freed: the stages are destroyed in reverse creation order (destroy only calls the destructor
+    // of the types that have one; for trivially destructible stages it compiles to nothing), then the arena is
+    // rewound.
+    void reset()
+    {
+        for (std::size_t k{count}; k-- > 0; ) { visit_slot(order[k], destroy, std::index_sequence_for<Ts...>{}); }
+        slots.fill(nullptr);
+        top = 0;
+        count = 0;
+    }
+
+    std::size_t used() const { return top; }
+
+private:
+    static constexpr auto destroy = [](auto& stage)
+    {
+        using T = std::decay_t<decltype(stage)>;
+        if constexpr (!std::is_trivially_destructible_v<T>) { stage.~T(); }
+    };
+
+    template <typename F, std::size_t... Is>
+    void visit_slot(std::size_t s, F& f, std::index_sequence<Is...>)
+    {
+        ((s == Is ? f(get<Ts>()) : void()), ...);
+    }
+
+    alignas(Ts...) std::byte buffer[capacity];
+    std::size_t top{0};
+    std::array<void*, N> slots{};
+    std::array<std::uint8_t, N> order{};
+    std::size_t count{0};
+};
+
+
+namespace detail
+{
+   template <typename T>
+   struct create
+   {
+      template <typename S>
+      void operator()(S& storage)
+      {
+        using ds = typename T::depends_on;
+        detail::create<ds>{}(storage);
+        if (!storage.template has<T>())
+        {
+          std::cout << "creating " << T{} << '\n';
+          storage.template emplace<T>();
+        }
+      }
+   };
+
+   template <typename... Ds>
+   struct create<std::tuple<Ds...>>
+   {
+       template <typename S>
+       void operator()(S& storage)
+       {
+            (detail::create<Ds>{}(storage),...);
+       }
+   };
+}
+
+
+template <template <typename...> typename Storage, typename... Ts>
+struct VarVectorBuilder
+{
+   template <typename T>
+   void create()
+   {
+        detail::create<T>{}(storage);
+   }
+
+   Storage<Ts...> storage;
+};
+
+
+int main()
+{
+    VarVectorBuilder<vector_storage, A1, B1, B2, C1> vec_builder;
+    vec_builder.create<C1>();
+    vec_builder.storage.for_each([](auto const& s) { std::cout << s; });  // A1B2B1C1
+    std::cout << '\n';
+
+    VarVectorBuilder<arena_storage, A1, B1, B2, C1> arena_builder;
+    arena_builder.create<B1>();
+    A1* a1 = &arena_builder.storage.get<A1>();
+    arena_builder.create<C1>();
+    arena_builder.storage.for_each([](auto const& s) { std::cout << s; });  // A1B2B1C1
+    std::cout << '\n';
+
+    // C1 was created after A1, but A1 did not move.
+    std::cout << "A1 stable: " << (a1 == &arena_builder.storage.get<A1>()) << '\n';  // 1
+    std::cout << "A1 once: " << (a1 == &arena_builder.storage.emplace<A1>()) << '\n';    // 1
+    std::cout << "arena: " << arena_builder.storage.used() << " of " << decltype(arena_builder.storage)::capacity << " bytes used\n";
+
+    // a rebuild: rewind and go again, nothing is freed or allocated.
+    arena_builder.storage.reset();
+    arena_builder.create<B2>();
+    arena_builder.storage.for_each([](auto const& s) { std::cout << s; });  // A1B2
+    std::cout << '\n';
+}
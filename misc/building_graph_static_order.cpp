@@ -0,0 +1,173 @@
+#include <iostream>
+#include <utility>
+#include <type_traits>
+#include <tuple>
+
+// In building_graph.cpp, VarVectorBuilder::create<T>() walks T::depends_on at run time, and for every
+// dependency, detail::create_dep scans the vector of variants with std::get_if.
+// But the graph is made of types, so it is fully known at compile time.
+// Here the compiler does the depth first search, gives us the topological order as a type list,
+// and the pipeline is a std::tuple in that order: no searching at run time at all.
+
+template <typename... Args>
+struct types_list {};
+
+
+struct A1
+{
+   using depends_on = std::tuple<>;
+   friend std::ostream& operator<<(std::ostream& os, A1 const&) { return os << "A1"; }
+};
+
+struct B2
+{
+   using depends_on = std::tuple<A1>;
+   friend std::ostream& operator<<(std::ostream& os, B2 const&) { return os << "B2"; }
+};
+
+struct B1
+{
+   using depends_on = std::tuple<A1, B2>;
+   friend std::ostream& operator<<(std::ostream& os, B1 const&) { return os << "B1"; }
+};
+
+struct C1
+{
+   using depends_on = std::tuple<B1, B2>;
+   friend std::ostream& operator<<(std::ostream& os, C1 const&) { return os << "C1"; }
+};
+
+
+namespace detail
+{
+
+template <typename T, typename TypeList>
+struct type_exists;
+
+template <typename T, typename... Args>
+struct type_exists<T, types_list<Args...>> : std::bool_constant<(std::is_same_v<T, Args> || ...)> {};
+
+template <typename T, typename TypeList>
+constexpr bool type_exists_v = type_exists<T, TypeList>::value;
+
+
+template <typename T, typename TypeList>
+struct append;
+
+template <typename T, typename... Args>
+struct append<T, types_list<Args...>>
+{
+    using type = types_list<Args..., T>;
+};
+
+
+// visit<T, Path, Done>: depth first search from T.
+//  - Path is the list of types we are currently inside (to detect cycles).
+//  - Done is the topological order built so far.
+template <typename T, typename Path, typename Done, bool already_done = type_exists_v<T, Done>>
+struct visit;
+
+template <typename Deps, typename Path, typename Done>
+struct visit_all;
+
+// T is already in the order: nothing to do. This is what replaces the get_if scan.
+template <typename T, typename Path, typename Done>
+struct visit<T, Path, Done, true>
+{
+    using type = Done;
+};
+
+template <typename T, typename... Path, typename Done>
+struct visit<T, types_list<Path...>, Done, false>
+{
+    static constexpr bool is_cycle = type_exists_v<T, types_list<Path...>>;
+    static_assert(!is_cycle, "depends_on has a cycle");
+
+    // on a cycle, stop walking (otherwise the compiler recurses until its depth limit).
+    using deps = std::conditional_t<is_cycle, std::tuple<>, typename T::depends_on>;
+    using deps_done = typename visit_all<deps, types_list<Path..., T>, Done>::type;
+    using type = typename append<T, deps_done>::type;
+};
+
+template <typename Path, typename Done>
+struct visit_all<std::tuple<>, Path, Done>
+{
+    using type = Done;
+};
+
+template <typename D, typename... Ds, typename Path, typename Done>
+struct visit_all<std::tuple<D, Ds...>, Path, Done>
+{
+    using type = typename visit_all<std::tuple<Ds...>, Path, typename visit<D, Path, Done>::type>::type;
+};
+
+}
+
+
+// The topological order of everything reachable from Ts... (dependencies first).
+template <typename... Ts>
+struct topological_order
+{
+    using type = typename detail::visit_all<std::tuple<Ts...>, types_list<>, types_list<>>::type;
+};
+
+template <typename... Ts>
+using topological_order_t = typename topological_order<Ts...>::type;
+
+
+template <typename TypeList>
+struct static_pipeline;
+
+// The stages live in a std::tuple: a fixed layout, and std::get<T> is resolved at compile time.
+// They are constructed in topological order, so when a stage is built, its dependencies are ready.
+template <typename... Ts>
+struct static_pipeline<types_list<Ts...>>
+{
+   using order = types_list<Ts...>;
+
+   static_pipeline() : stages{make<Ts>()...} {}
+
+   template <typename T>
+   T& get() { return std::get<T>(stages); }
+
+   template <typename F>
+   void for_each(F f) { std::apply([&](auto&... s) { (f(s), ...); }, stages); }
+
+private:
+   template <typename T>
+   static T make()
+   {
+       std::cout << "creating " << T{} << '\n';
+       return T{};
+   }
+
+   // The braced init list above evaluates make<Ts>() left to right, so the creation order is the
+   // topological order.
+   std::tuple<Ts...> stages;
+};
+
+template <typename... Ts>
+auto create_pipeline()
+{
+    return static_pipeline<topological_order_t<Ts...>>{};
+}
+
+
+// A stage that depends on itself indirectly; uncomment the static_assert in main to see the error.
+struct X2;
+struct X1 { using depends_on = std::tuple<X2>; };
+struct X2 { using depends_on = std::tuple<X1>; };
+
+
+int main()
+{
+    static_assert(std::is_same_v<topological_order_t<C1>, types_list<A1, B2, B1, C1>>);
+    static_assert(std::is_same_v<topological_order_t<B1, C1, A1, B2>, types_list<A1, B2, B1, C1>>);
+    static_assert(std::is_same_v<topological_order_t<B2>, types_list<A1, B2>>);
+    // static_assert(std::is_same_v<topological_order_t<X1>, types_list<>>);  // error: depends_on has a cycle
+
+    auto pipeline = create_pipeline<B1, C1, A1, B2>();
+    pipeline.for_each([](auto& s) { std::cout << s; });  // A1B2B1C1
+    std::cout << '\n';
+    std::cout << pipeline.get<C1>() << '\n';
+}
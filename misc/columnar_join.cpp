@@ -0,0 +1,330 @@
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <vector>
+#include <array>
+#include <tuple>
+#include <string>
+#include <iterator>
+#include <functional>
+#include <type_traits>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <chrono>
+#include <random>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MY_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+// my::join (set_intersection.cpp) walks arrays of structs: every comparison reads an S{id, v} or an M{id, v},
+// and the combiner gets whole objects. With wide rows (a key and 100+ bytes of payload), each key compared
+// brings its payload into the cache too, and most of the memory traffic is data the comparisons never look at.
+//
+// Late materialization, as column stores do it:
+//   1. join_indices runs the loop of my::join on the key columns alone (one contiguous array per side) and
+//      writes the matches as two columns of row numbers, left[k] and right[k],
+//   2. gather(column, rows) builds each payload column of the result, column[rows[k]], in one pass per column;
+//      the rows are increasing on the left side, and mostly local on the right side, so the reads stream.
+// Only the payload columns the query wants are read, and only for the rows that matched.
+//
+// gather uses the AVX2 gather instructions for 4 and 8 byte columns (picked at run time, like
+// set_intersection_simd.cpp), and a prefetching loop otherwise. Row numbers are std::uint32_t, which the AVX2
+// gathers read as signed 32 bit offsets: up to 2^31 - 1 rows per side (join_indices throws std::length_error
+// beyond).
+
+namespace my
+{
+
+  template <typename Iterator1, typename Iterator2, typename OutIterator, typename Comparator,
+            typename Combiner
+            >
+  OutIterator join(Iterator1 first1, Iterator1 last1,
+                               Iterator2 first2, Iterator2 last2,
+                               OutIterator out_it,
+                               Comparator cmp,
+                               Combiner&& comb)
+  {
+
+    for (auto fixed_f2=first2 ; (first1 != last1) && (fixed_f2 != last2) ; )
+    {
+         if      ((first2 == last2) || cmp(*first1, *first2)) { first1++; first2 = fixed_f2;}
+         else if (cmp(*first2, *first1)) { first2++; fixed_f2 = first2; }
+         else                            { *out_it++ = comb(*first1, *first2++); }
+    }
+    return out_it;
+  }
+
+
+  using row_t = std::uint32_t;
+
+  // The most rows per side: the AVX2 gathers take the row numbers as signed 32 bit offsets.
+  constexpr std::size_t max_rows = static_cast<std::size_t>(std::numeric_limits<std::int32_t>::max());
+
+  // The matches of a join, as two columns: row left[k] of the first table goes with row right[k] of the second.
+  struct join_rows
+  {
+    std::vector<row_t> left;
+    std::vector<row_t> right;
+
+    std::size_t size() const { return left.size(); }
+  };
+
+
+  // The loop of my::join, on two sorted key columns, with row numbers for output.
+  template <typename Key1, typename Key2, typename Comparator = std::less<>>
+  join_rows join_indices(Key1 const* keys1, std::size_t n1, Key2 const* keys2, std::size_t n2, Comparator cmp = {})
+  {
+    if ((n1 > max_rows) || (n2 > max_rows)) { throw std::length_error{"join_indices: more than 2^31 - 1 rows"}; }
+
+    join_rows out;
+    std::size_t first1{0}, first2{0};
+    for (std::size_t fixed_f2{0} ; (first1 != n1) && (fixed_f2 != n2) ; )
+    {
+         if      ((first2 == n2) || cmp(keys1[first1], keys2[first2])) { first1++; first2 = fixed_f2;}
+         else if (cmp(keys2[first2], keys1[first1])) { first2++; fixed_f2 = first2; }
+         else
+         {
+           out.left.push_back(static_cast<row_t>(first1));
+           out.right.push_back(static_cast<row_t>(first2++));
+         }
+    }
+    return out;
+  }
+
+  template <typename Key1, typename Key2, typename Comparator = std::less<>>
+  join_rows join_indices(std::vector<Key1> const& keys1, std::vector<Key2> const& keys2, Comparator cmp = {})
+  {
+    return join_indices(keys1.data(), keys1.size(), keys2.data(), keys2.size(), cmp);
+  }
+
+
+  namespace detail
+  {
+    // Rows ahead of the current one to prefetch in the scalar gather.
+    constexpr std::size_t gather_prefetch = 16;
+
+    template <typename T>
+    void gather_scalar(T const* column, row_t const* rows, std::size_t n, T* out)
+    {
+      std::size_t i{0};
+      for ( ; i + gather_prefetch < n; ++i)
+      {
+        __builtin_prefetch(column + rows[i + gather_prefetch]);
+        out[i] = column[rows[i]];
+      }
+      for ( ; i < n; ++i) { out[i] = column[rows[i]]; }
+    }
+
+#if defined(MY_SIMD_X86)
+    __attribute__((target("avx2")))
+    inline void gather_avx2_32(void const* column, row_t const* rows, std::size_t n, void* out)
+    {
+      auto const* base = static_cast<int const*>(column);
+      auto* dst = static_cast<int*>(out);
+      std::size_t i{0};
+      for ( ; i + 8 <= n; i += 8)
+      {
+        __m256i const idx = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(rows + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_i32gather_epi32(base, idx, 4));
+      }
+      for ( ; i < n; ++i) { std::memcpy(dst + i, base + rows[i], 4); }   // the column may hold floats/doubles
+    }
+
+    __attribute__((target("avx2")))
+    inline void gather_avx2_64(void const* column, row_t const* rows, std::size_t n, void* out)
+    {
+      auto const* base = static_cast<long long const*>(column);
+      auto* dst = static_cast<long long*>(out);
+      std::size_t i{0};
+      for ( ; i + 4 <= n; i += 4)
+      {
+        __m128i const idx = _mm_loadu_si128(reinterpret_cast<__m128i const*>(rows + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_i32gather_epi64(base, idx, 8));
+      }
+      for ( ; i < n; ++i) { std::memcpy(dst + i, base + rows[i], 8); }   // the column may hold floats/doubles
+    }
+#endif
+
+    using gather_kernel_t = void (*)(void const*, row_t const*, std::size_t, void*);
+
+    template <std::size_t size>
+    gather_kernel_t pick_gather_kernel()
+    {
+#if defined(MY_SIMD_X86)
+      __builtin_cpu_init();
+      if (__builtin_cpu_supports("avx2"))
+      {
+        if constexpr (size == 4) { return &gather_avx2_32; }
+        if constexpr (size == 8) { return &gather_avx2_64; }
+      }
+#endif
+      return nullptr;
+    }
+  }
+
+
+  // out[k] = column[rows[k]], for k in [0, rows.size()).
+  template <typename T>
+  void gather(T const* column, std::vector<row_t> const& rows, T* out)
+  {
+    if constexpr (std::is_trivially_copyable_v<T> && ((sizeof(T) == 4) || (sizeof(T) == 8)))
+    {
+      static detail::gather_kernel_t const kernel = detail::pick_gather_kernel<sizeof(T)>();
+      if (kernel) { kernel(column, rows.data(), rows.size(), out); return; }
+    }
+    detail::gather_scalar(column, rows.data(), rows.size(), out);
+  }
+
+  template <typename T>
+  std::vector<T> gather(std::vector<T> const& column, std::vector<row_t> const& rows)
+  {
+    std::vector<T> out(rows.size());
+    gather(column.data(), rows, out.data());
+    return out;
+  }
+}
+
+
+
+
+struct S
+{
+   explicit S(int id_, int v_) : id{id_}, v{v_} {}
+   int id;
+   int v;
+};
+
+
+struct M
+{
+   explicit M(int id_, int v_) : id{id_}, v{v_} {}
+   int id;
+   int v;
+};
+
+std::ostream& operator<<(std::ostream& os, S s) { return os << "S{" << s.id << ", " << s.v << "}"; }
+std::ostream& operator<<(std::ostream& os, M m) { return os << "M{" << m.id << ", " << m.v << "}"; }
+
+struct cmp
+{
+    bool operator()(S s, M m) const { return s.id < m.id; }
+    bool operator()(M m, S s) const { return m.id < s.id; }
+};
+
+
+// A wide row: the key, one field the query wants, and 120 bytes it doesn't.
+struct wide_row
+{
+    int id;
+    double price;
+    char payload[120];
+};
+
+// The same table by columns.
+struct wide_table
+{
+    std::vector<int> id;
+    std::vector<double> price;
+    std::vector<std::array<char, 120>> payload;
+};
+
+
+int main()
+{
+    // The example of set_intersection.cpp, by columns.
+    {
+        std::vector<int> A_id{-1, 2, 2, 5}, A_v{7, 2, 3, 5};   // M{-1,7} M{2,2} M{2,3} M{5,5}
+        std::vector<int> B_id{-1, 2, 2},    B_v{0, 1, 4};      // S{-1,0} S{2,1} S{2,4}
+
+        auto rows = my::join_indices(A_id, B_id);
+        auto a_v = my::gather(A_v, rows.left);
+        auto b_v = my::gather(B_v, rows.right);
+        auto ids = my::gather(A_id, rows.left);
+
+        std::cout << "C: ";
+        for (std::size_t k{0}; k < rows.size(); ++k) { std::cout << M{ids[k], a_v[k]} << "-" << S{ids[k], b_v[k]} << ' '; }
+        std::cout << '\n';
+        // This prints: C: M{-1, 7}-S{-1, 0} M{2, 2}-S{2, 1} M{2, 2}-S{2, 4} M{2, 3}-S{2, 1} M{2, 3}-S{2, 4}
+        // which is the output of my::join on the same rows:
+        std::vector<M> A{M{-1,7}, M{2,2}, M{2,3}, M{5,5}};
+        std::vector<S> B{S{-1,0}, S{2,1}, S{2,4}};
+        std::vector<std::string> C;
+        my::join(A.cbegin(), A.cend(), B.cbegin(), B.cend(), std::back_inserter(C), cmp{},
+                 [](M m, S s) { std::ostringstream os; os << m << "-" << s; return os.str(); });
+        std::cout << "C: ";  for (auto c: C) { std::cout << c << ' '; } std::cout << '\n';
+    }
+
+    // Two tables of 4M wide rows, sorted on id, 1 row in 8 matches: the price of both sides, per match.
+    constexpr std::size_t n = 4'000'000;
+    std::mt19937 gen{43};
+    std::uniform_int_distribution<int> pick{0, static_cast<int>(8 * n)};
+    auto make_ids = [&]()
+    {
+        std::vector<int> ids(n);
+        for (auto& id: ids) { id = pick(gen); }
+        std::sort(ids.begin(), ids.end());
+        return ids;
+    };
+    auto const ids1 = make_ids();
+    auto const ids2 = make_ids();
+
+    std::vector<wide_row> rows1(n), rows2(n);
+    wide_table cols1, cols2;
+    for (auto [ids, rows, cols]: {std::tuple{&ids1, &rows1, &cols1}, std::tuple{&ids2, &rows2, &cols2}})
+    {
+        cols->id = *ids;
+        cols->price.resize(n);
+        cols->payload.resize(n);
+        for (std::size_t i{0}; i < n; ++i)
+        {
+            double const price = static_cast<double>((*ids)[i]) * 0.25 + static_cast<double>(i % 7);
+            (*rows)[i].id = (*ids)[i];
+            (*rows)[i].price = price;
+            std::memset((*rows)[i].payload, static_cast<int>(i), sizeof((*rows)[i].payload));
+            cols->price[i] = price;
+            cols->payload[i].fill(static_cast<char>(i));
+        }
+    }
+
+    auto time = [](auto f)
+    {
+        auto start = std::chrono::steady_clock::now();
+        auto r = f();
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+        return std::pair{std::move(r), ms};
+    };
+
+    using priced = std::pair<double, double>;
+
+    // Rows: my::join on whole rows, the combiner picks the prices.
+    auto [by_rows, t_rows] = time([&]()
+    {
+        std::vector<priced> out;
+        my::join(rows1.cbegin(), rows1.cend(), rows2.cbegin(), rows2.cend(), std::back_inserter(out),
+                 [](wide_row const& a, wide_row const& b) { return a.id < b.id; },
+                 [](wide_row const& a, wide_row const& b) { return priced{a.price, b.price}; });
+        return out;
+    });
+
+    // Columns: the ids, then the two price columns for the matches.
+    auto [by_cols, t_cols] = time([&]()
+    {
+        auto rows = my::join_indices(cols1.id, cols2.id);
+        return std::pair{my::gather(cols1.price, rows.left), my::gather(cols2.price, rows.right)};
+    });
+
+    bool same = (by_rows.size() == by_cols.first.size());
+    for (std::size_t k{0}; same && (k < by_rows.size()); ++k)
+    {
+        same = (by_rows[k].first == by_cols.first[k]) && (by_rows[k].second == by_cols.second[k]);
+    }
+
+    std::cout << "join on rows (" << sizeof(wide_row) << " bytes each): " << by_rows.size() << " matches in " << t_rows << "ms\n";
+    std::cout << "join on key columns + gather:   " << by_cols.first.size() << " matches in " << t_cols << "ms"
+              << (same ? "" : " (DIFFERENT)") << '\n';
+}
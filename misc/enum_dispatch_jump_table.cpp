@@ -0,0 +1,230 @@
+#include <iostream>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <chrono>
+#include <random>
+#include <stdexcept>
+
+// get_type<Type::Integer, int, double> maps an enum to a type, but only at compile time.
+// On the wire, the enum is a runtime value, and we want to call a kernel instantiated for the matching type.
+// Usually that's a chain of ifs (or converting to a std::variant and calling std::visit).
+//
+// dispatch builds, at compile time, a table of function pointers over the enum range:
+//   table[i] calls Kernel<get_type_t<Enum(i), Types>>::run
+// and a runtime call is one bounds check and one indirect call.
+
+template <typename... Args>
+struct types_list;
+
+
+namespace detail
+{
+    template <std::size_t N, typename... Args>
+    struct get_type;
+
+    template <typename T, typename... Others>
+    struct get_type<0, T, Others...>
+    {
+        using type = T;
+    };
+
+    template <std::size_t N, typename T, typename... Others>
+    struct get_type<N, T, Others...>
+    {
+        using type = typename get_type<N-1, Others...>::type;
+    };
+}
+
+
+namespace detail
+{
+
+  constexpr std::size_t get_number(std::size_t n) { return n; }
+
+  template <typename T>
+  constexpr std::size_t get_number(T n) { return static_cast<std::size_t>(n); }
+}
+
+template <auto N, typename... Args>
+struct get_type_base
+{
+   static constexpr std::size_t n = detail::get_number(N);
+   using type = typename detail::get_type<n, Args...>::type;
+};
+
+
+template <auto  N, typename... Args>
+struct get_type : get_type_base<N, Args...>
+{
+};
+
+template <auto  N, typename... Args>
+struct get_type<N, types_list<Args...>> : get_type_base<N, Args...>
+{
+};
+
+template <auto N, typename... Args>
+using get_type_t = typename get_type<N, Args...>::type;
+
+
+template <typename TypeList>
+struct types_count;
+
+template <typename... Args>
+struct types_count<types_list<Args...>> : std::integral_constant<std::size_t, sizeof...(Args)> {};
+
+
+namespace detail
+{
+    template <typename Enum, typename TypeList, template <typename> typename Kernel, typename Indices, typename... Args>
+    struct dispatch_table;
+
+    template <typename Enum, typename TypeList, template <typename> typename Kernel, std::size_t... Is, typename... Args>
+    struct dispatch_table<Enum, TypeList, Kernel, std::index_sequence<Is...>, Args...>
+    {
+        // Every kernel must have the same signature; the first one decides it.
+        using result_type = decltype(Kernel<get_type_t<static_cast<Enum>(0), TypeList>>::run(std::declval<Args>()...));
+        using fn_t = result_type (*)(Args...);
+
+        // A thunk per type, so every entry has exactly the signature fn_t (run itself may take its
+        // arguments by value, by const&, or need a conversion).
+        template <typename T>
+        static result_type call(Args... args) { return Kernel<T>::run(std::forward<Args>(args)...); }
+
+        // get_type goes through detail::get_number, so this works for an enum class as well.
+        static constexpr fn_t table[] = {&call<get_type_t<static_cast<Enum>(Is), TypeList>>...};
+    };
+}
+
+// Calls Kernel<T>::run(args...), T being the type that e maps to in TypeList.
+// The enum values must be 0, 1, ..., n-1 (n is the number of types in TypeList).
+template <typename Enum, typename TypeList, template <typename> typename Kernel, typename... Args>
+decltype(auto) dispatch(Enum e, Args&&... args)
+{
+    constexpr std::size_t n = types_count<TypeList>::value;
+    using table_t = detail::dispatch_table<Enum, TypeList, Kernel, std::make_index_sequence<n>, Args&&...>;
+
+    std::size_t const i = detail::get_number(e);
+    if (i >= n) { throw std::out_of_range("dispatch: enum value out of range"); }
+    return table_t::table[i](std::forward<Args>(args)...);
+}
+
+
+// ------------------------------------------------------------------------------------------------
+// Example: a message is (type tag, 8 bytes of payload); the kernel decodes the payload as T.
+// ------------------------------------------------------------------------------------------------
+
+enum class Type : std::uint8_t { Integer = 0, Float, Double, Short };
+using wire_types = types_list<std::int32_t, float, double, std::int16_t>;
+
+struct message
+{
+    Type type;
+    unsigned char payload[8];
+};
+
+template <typename T>
+struct decode
+{
+    static double run(unsigned char const* p)
+    {
+        T t;
+        std::memcpy(&t, p, sizeof(T));
+        return static_cast<double>(t);
+    }
+};
+
+template <typename T>
+message make_message(Type type, T t)
+{
+    message m{type, {}};
+    std::memcpy(m.payload, &t, sizeof(T));
+    return m;
+}
+
+
+// The two usual alternatives, for the benchmark.
+double decode_if_chain(message const& m)
+{
+    if      (m.type == Type::Integer) { return decode<std::int32_t>::run(m.payload); }
+    else if (m.type == Type::Float)   { return decode<float>::run(m.payload); }
+    else if (m.type == Type::Double)  { return decode<double>::run(m.payload); }
+    else if (m.type == Type::Short)   { return decode<std::int16_t>::run(m.payload); }
+    throw std::out_of_range("decode_if_chain: enum value out of range");
+}
+
+template <typename T>
+struct tag { using type = T; };
+
+using tag_variant = std::variant<tag<std::int32_t>, tag<float>, tag<double>, tag<std::int16_t>>;
+
+// std::visit needs a variant, and getting one from the enum is a switch anyway. That's the point.
+tag_variant to_variant(Type t)
+{
+    switch (t)
+    {
+        case Type::Integer: return tag<std::int32_t>{};
+        case Type::Float:   return tag<float>{};
+        case Type::Double:  return tag<double>{};
+        case Type::Short:   return tag<std::int16_t>{};
+    }
+    throw std::out_of_range("to_variant: enum value out of range");
+}
+
+double decode_visit(message const& m)
+{
+    return std::visit([&](auto t) { return decode<typename decltype(t)::type>::run(m.payload); }, to_variant(m.type));
+}
+
+
+int main()
+{
+    static_assert(std::is_same_v<get_type_t<Type::Double, wire_types>, double>);
+
+    auto m = make_message(Type::Float, 2.5f);
+    std::cout << dispatch<Type, wire_types, decode>(m.type, m.payload) << '\n';   // 2.5
+
+    try
+    {
+        dispatch<Type, wire_types, decode>(static_cast<Type>(9), m.payload);
+    }
+    catch (std::out_of_range const& e)
+    {
+        std::cout << e.what() << '\n';
+    }
+
+    // The benchmark: random message types, so the branch predictor can't learn the sequence.
+    constexpr std::size_t n = 5'000'000;
+    std::vector<message> msgs;
+    msgs.reserve(n);
+    std::mt19937 gen{7};
+    std::uniform_int_distribution<int> pick{0, 3};
+    for (std::size_t i{0}; i < n; ++i)
+    {
+        int const v = static_cast<int>(i % 1000);
+        switch (pick(gen))
+        {
+            case 0:  msgs.push_back(make_message(Type::Integer, std::int32_t(v))); break;
+            case 1:  msgs.push_back(make_message(Type::Float, float(v)));          break;
+            case 2:  msgs.push_back(make_message(Type::Double, double(v)));        break;
+            default: msgs.push_back(make_message(Type::Short, std::int16_t(v)));   break;
+        }
+    }
+
+    auto bench = [&](char const* name, auto f)
+    {
+        auto start = std::chrono::steady_clock::now();
+        double s{0};
+        for (auto const& msg: msgs) { s += f(msg); }
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+        std::cout << name << s << " in " << us << "us\n";
+    };
+
+    bench("if chain:   ", decode_if_chain);
+    bench("std::visit: ", decode_visit);
+    bench("jump table: ", [](message const& msg) { return dispatch<Type, wire_types, decode>(msg.type, msg.payload); });
+}
@@ -0,0 +1,527 @@
+#include <iostream>
+#include <algorithm>
+#include <vector>
+#include <string>
+#include <queue>
+#include <iterator>
+#include <type_traits>
+#include <system_error>
+#include <stdexcept>
+#include <new>
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <cerrno>
+#include <chrono>
+#include <random>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// my::join (set_intersection.cpp) takes iterators, so it does not care where the elements are. Here they are in
+// files of fixed size records, bigger than the memory of the machine:
+//
+//   - mapped_file<T> maps a file read only, and streaming_iterator<T> walks it. Every `window` bytes, the
+//     iterator asks the kernel to read the next window ahead (MADV_WILLNEED) and to drop the window before
+//     the previous one (MADV_DONTNEED), so the join never waits for the disk and its resident set stays
+//     around 3 windows per input. Huge pages are requested (MADV_HUGEPAGE); where the kernel can't do it
+//     for files, that's a no-op.
+//   - external_sort sorts a file that doesn't fit: sorted runs of memory_budget bytes, then k-way merges of
+//     at most fan_in runs at a time (more passes if needed), each run read through a small buffer.
+//   - external_join checks that both files are sorted, sorts the ones that are not (into temporary files),
+//     and runs my::join on the two mappings.
+//
+// The records must be trivially copyable (they are the bytes of the file), and the RAM used is bounded by
+// memory_budget (the sort) and the windows (the join), not by the size of the files.
+
+namespace my
+{
+
+  template <typename Iterator1, typename Iterator2, typename OutIterator, typename Comparator,
+            typename Combiner
+            >
+  OutIterator join(Iterator1 first1, Iterator1 last1,
+                               Iterator2 first2, Iterator2 last2,
+                               OutIterator out_it,
+                               Comparator cmp,
+                               Combiner&& comb)
+  {
+
+    for (auto fixed_f2=first2 ; (first1 != last1) && (fixed_f2 != last2) ; )
+    {
+         if      ((first2 == last2) || cmp(*first1, *first2)) { first1++; first2 = fixed_f2;}
+         else if (cmp(*first2, *first1)) { first2++; fixed_f2 = first2; }
+         else                            { *out_it++ = comb(*first1, *first2++); }
+    }
+    return out_it;
+  }
+
+
+  struct external_options
+  {
+    std::size_t memory_budget = std::size_t(256) << 20;  // the sort's buffers
+    std::size_t window = std::size_t(32) << 20;          // the join's read ahead, per input
+    std::size_t merge_buffer = std::size_t(1) << 20;     // per run in a merge; decides the fan in
+    std::string tmp_dir = "/tmp";
+  };
+
+
+  namespace detail
+  {
+    [[noreturn]] inline void throw_errno(std::string const& what)
+    {
+      throw std::system_error(errno, std::generic_category(), what);
+    }
+
+    inline std::size_t page_size()
+    {
+      static std::size_t const size = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+      return size;
+    }
+
+    inline std::uintptr_t page_down(std::uintptr_t p) { return p & ~(page_size() - 1); }
+
+    // A file descriptor that closes itself.
+    class file
+    {
+    public:
+      file(std::string const& path, int flags, mode_t mode = 0644) : fd{::open(path.c_str(), flags, mode)}
+      {
+        if (fd < 0) { throw_errno("open " + path); }
+      }
+      file(file&& other) noexcept : fd{other.fd} { other.fd = -1; }
+      file(file const&) = delete;
+      file& operator=(file const&) = delete;
+      ~file() { if (fd >= 0) { ::close(fd); } }
+
+      std::size_t size() const
+      {
+        struct stat st;
+        if (::fstat(fd, &st) != 0) { throw_errno("fstat"); }
+        return static_cast<std::size_t>(st.st_size);
+      }
+
+      // read/write may do less than asked: loop.
+      std::size_t read(void* p, std::size_t n)
+      {
+        std::size_t done{0};
+        while (done < n)
+        {
+          ssize_t const r = ::read(fd, static_cast<char*>(p) + done, n - done);
+          if (r < 0) { if (errno == EINTR) { continue; } throw_errno("read"); }
+          if (r == 0) { break; }
+          done += static_cast<std::size_t>(r);
+        }
+        return done;
+      }
+
+      void write(void const* p, std::size_t n)
+      {
+        std::size_t done{0};
+        while (done < n)
+        {
+          ssize_t const r = ::write(fd, static_cast<char const*>(p) + done, n - done);
+          if (r < 0) { if (errno == EINTR) { continue; } throw_errno("write"); }
+          done += static_cast<std::size_t>(r);
+        }
+      }
+
+      int fd;
+    };
+
+    // A temporary file name in dir, removed with the object.
+    class temp_path
+    {
+    public:
+      explicit temp_path(std::string const& dir)
+      {
+        std::string pattern = dir + "/external_join_XXXXXX";
+        int const fd = ::mkstemp(pattern.data());
+        if (fd < 0) { throw_errno("mkstemp in " + dir); }
+        ::close(fd);
+        path = pattern;
+      }
+      temp_path(temp_path&& other) noexcept : path{std::move(other.path)} { other.path.clear(); }
+      temp_path& operator=(temp_path&&) = delete;
+      ~temp_path() { if (!path.empty()) { ::unlink(path.c_str()); } }
+
+      std::string path;
+    };
+  }
+
+
+  template <typename T>
+  class mapped_file
+  {
+    static_assert(std::is_trivially_copyable_v<T>, "the records are the bytes of the file");
+
+  public:
+    mapped_file(std::string const& path, std::size_t window_)
+      : f{path, O_RDONLY}, bytes{f.size()}, window{std::max(detail::page_size(), window_ / detail::page_size() * detail::page_size())}
+    {
+      if (bytes % sizeof(T) != 0) { throw std::runtime_error(path + ": not a whole number of records"); }
+      if (bytes == 0) { return; }
+
+      void* p = ::mmap(nullptr, bytes, PROT_READ, MAP_PRIVATE, f.fd, 0);
+      if (p == MAP_FAILED) { detail::throw_errno("mmap " + path); }
+      data = static_cast<T const*>(p);
+
+      ::madvise(p, bytes, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+      ::madvise(p, bytes, MADV_HUGEPAGE);   // best effort: file backed huge pages need kernel support.
+#endif
+      prefetch(0);
+    }
+
+    mapped_file(mapped_file const&) = delete;
+    mapped_file& operator=(mapped_file const&) = delete;
+    ~mapped_file() { if (data) { ::munmap(const_cast<T*>(data), bytes); } }
+
+    std::size_t size() const { return bytes / sizeof(T); }
+    std::size_t window_records() const { return std::max<std::size_t>(1, window / sizeof(T)); }
+
+    // Called when an iterator crosses into a new window at `offset` (in bytes): read the next one ahead,
+    // drop the one before the previous one (a rewind of my::join on a run of equal keys stays behind by a
+    // little; if it goes further, the pages just come back from the page cache).
+    void prefetch(std::size_t offset) const
+    {
+      auto const base = reinterpret_cast<std::uintptr_t>(data);
+      auto advise = [&](std::size_t from, std::size_t to, int advice)
+      {
+        to = std::min(to, bytes);
+        if (from >= to) { return; }
+        std::uintptr_t const start = detail::page_down(base + from);
+        ::madvise(reinterpret_cast<void*>(start), base + to - start, advice);
+      };
+      advise(offset + window, offset + 2 * window, MADV_WILLNEED);
+      if (offset >= 2 * window) { advise(offset - 2 * window, offset - window, MADV_DONTNEED); }
+    }
+
+    T const* begin_ptr() const { return data; }
+    T const* end_ptr() const { return data + size(); }
+
+  private:
+    detail::file f;
+    std::size_t bytes;
+    std::size_t window;
+    T const* data{nullptr};
+  };
+
+
+  // A pointer into a mapped_file, with a check per ++ for the next window mark.
+  template <typename T>
+  class streaming_iterator
+  {
+  public:
+    using value_type        = T;
+    using reference         = T const&;
+    using pointer           = T const*;
+    using difference_type   = std::ptrdiff_t;
+    using iterator_category = std::forward_iterator_tag;
+
+    streaming_iterator() = default;
+    streaming_iterator(mapped_file<T> const& file_, T const* p_)
+      : file{&file_}, p{p_}, mark{next_mark(p_)} {}
+
+    reference operator*() const { return *p; }
+    pointer operator->() const { return p; }
+
+    streaming_iterator& operator++()
+    {
+      if (++p == mark)
+      {
+        file->prefetch(static_cast<std::size_t>(p - file->begin_ptr()) * sizeof(T));
+        mark = next_mark(p);
+      }
+      return *this;
+    }
+    streaming_iterator operator++(int) { auto tmp = *this; ++*this; return tmp; }
+
+    friend bool operator==(streaming_iterator const& x, streaming_iterator const& y) { return x.p == y.p; }
+    friend bool operator!=(streaming_iterator const& x, streaming_iterator const& y) { return x.p != y.p; }
+
+  private:
+    T const* next_mark(T const* from) const
+    {
+      auto const w = file->window_records();
+      auto const i = static_cast<std::size_t>(from - file->begin_ptr());
+      return file->begin_ptr() + std::min(file->size(), (i / w + 1) * w);
+    }
+
+    mapped_file<T> const* file{nullptr};
+    T const* p{nullptr};
+    T const* mark{nullptr};
+  };
+
+  template <typename T>
+  streaming_iterator<T> begin(mapped_file<T> const& f) { return {f, f.begin_ptr()}; }
+
+  template <typename T>
+  streaming_iterator<T> end(mapped_file<T> const& f) { return {f, f.end_ptr()}; }
+
+
+  namespace detail
+  {
+    // The records of a buffer of bytes read from a file (T is trivially copyable; the buffer comes from
+    // operator new, aligned for any T).
+    template <typename T>
+    T const& record_at(std::vector<unsigned char> const& bytes, std::size_t i)
+    {
+      return *std::launder(reinterpret_cast<T const*>(bytes.data() + i * sizeof(T)));
+    }
+
+    // Reads a file through a buffer of n records.
+    template <typename T>
+    class run_reader
+    {
+    public:
+      run_reader(std::string const& path, std::size_t n) : f{path, O_RDONLY}, buffer(std::max<std::size_t>(1, n) * sizeof(T)) { refill(); }
+
+      bool done() const { return pos == count; }
+      T const& front() const { return record_at<T>(buffer, pos); }
+      void pop() { if (++pos == count) { refill(); } }
+
+    private:
+      void refill()
+      {
+        count = f.read(buffer.data(), buffer.size()) / sizeof(T);
+        pos = 0;
+      }
+
+      file f;
+      std::vector<unsigned char> buffer;   // T may not be default constructible (explicit constructors).
+      std::size_t pos{0};
+      std::size_t count{0};
+    };
+
+    // Writes a file through a buffer of n records. finish() writes the rest and reports errors; the destructor
+    // can't throw, so without finish() (an exception on the way) the rest is written on a best effort basis.
+    template <typename T>
+    class run_writer
+    {
+    public:
+      run_writer(std::string const& path, std::size_t n) : f{path, O_WRONLY | O_CREAT | O_TRUNC} { buffer.reserve(std::max<std::size_t>(1, n)); }
+      ~run_writer() { try { flush(); } catch (std::system_error const&) {} }
+
+      void push(T const& t) { buffer.push_back(t); if (buffer.size() == buffer.capacity()) { flush(); } }
+      void finish() { flush(); }
+
+    private:
+      void flush() { f.write(buffer.data(), buffer.size() * sizeof(T)); buffer.clear(); }
+
+      file f;
+      std::vector<T> buffer;
+    };
+
+    template <typename T, typename Less>
+    void merge_runs(std::vector<temp_path> const& runs, std::size_t from, std::size_t to,
+                    std::string const& out_path, std::size_t buffer_records, Less less)
+    {
+      std::vector<run_reader<T>> readers;
+      readers.reserve(to - from);
+      for (std::size_t r{from}; r < to; ++r) { readers.emplace_back(runs[r].path, buffer_records); }
+
+      // the heap holds the index of a reader; the smallest front on top, the earlier run first on ties.
+      auto greater = [&](std::size_t x, std::size_t y)
+      {
+        if (less(readers[y].front(), readers[x].front())) { return true; }
+        if (less(readers[x].front(), readers[y].front())) { return false; }
+        return x > y;
+      };
+      std::priority_queue<std::size_t, std::vector<std::size_t>, decltype(greater)> heap{greater};
+      for (std::size_t r{0}; r < readers.size(); ++r) { if (!readers[r].done()) { heap.push(r); } }
+
+      run_writer<T> out{out_path, buffer_records};
+      while (!heap.empty())
+      {
+        std::size_t const r = heap.top();
+        heap.pop();
+        out.push(readers[r].front());
+        readers[r].pop();
+        if (!readers[r].done()) { heap.push(r); }
+      }
+      out.finish();
+    }
+  }
+
+
+  // Sorts the records of in_path into out_path, with about options.memory_budget bytes of RAM.
+  template <typename T, typename Less>
+  void external_sort(std::string const& in_path, std::string const& out_path, Less less, external_options const& options = {})
+  {
+    static_assert(std::is_trivially_copyable_v<T>, "the records are the bytes of the file");
+
+    // 1. runs: fill the budget, sort, write.
+    // T may not be default constructible (explicit constructors), so a run is read as bytes and copied into
+    // a vector<T>: half the budget each.
+    std::vector<detail::temp_path> runs;
+    {
+      std::size_t const run_records = std::max<std::size_t>(1, options.memory_budget / sizeof(T) / 2);
+      detail::file in{in_path, O_RDONLY};
+      std::vector<unsigned char> bytes(run_records * sizeof(T));
+      std::vector<T> buffer;
+      buffer.reserve(run_records);
+      for (;;)
+      {
+        std::size_t const n = in.read(bytes.data(), bytes.size()) / sizeof(T);
+        if (n == 0) { break; }
+        buffer.clear();
+        for (std::size_t i{0}; i < n; ++i) { buffer.push_back(detail::record_at<T>(bytes, i)); }
+        std::stable_sort(buffer.begin(), buffer.end(), less);
+        runs.emplace_back(options.tmp_dir);
+        detail::file{runs.back().path, O_WRONLY | O_TRUNC}.write(buffer.data(), n * sizeof(T));
+        if (n < run_records) { break; }
+      }
+    }
+
+    // 2. merge passes: fan_in runs into one, until one is left. Each run gets merge_buffer bytes.
+    std::size_t const buffer_records = std::max<std::size_t>(1, options.merge_buffer / sizeof(T));
+    std::size_t const fan_in = std::max<std::size_t>(2, options.memory_budget / options.merge_buffer - 1);
+    while (runs.size() > 1)
+    {
+      std::vector<detail::temp_path> next;
+      for (std::size_t from{0}; from < runs.size(); from += fan_in)
+      {
+        std::size_t const to = std::min(runs.size(), from + fan_in);
+        next.emplace_back(options.tmp_dir);
+        detail::merge_runs<T>(runs, from, to, next.back().path, buffer_records, less);
+      }
+      runs = std::move(next);
+    }
+
+    // 3. the last run is the output (or an empty file).
+    if (runs.empty()) { detail::file{out_path, O_WRONLY | O_CREAT | O_TRUNC}; return; }
+    if (::rename(runs.front().path.c_str(), out_path.c_str()) == 0) { runs.front().path.clear(); return; }
+    detail::merge_runs<T>(runs, 0, 1, out_path, buffer_records, less);  // another file system: copy.
+  }
+
+
+  namespace detail
+  {
+    // path if its records are sorted, else a temporary sorted copy of it.
+    template <typename T, typename Less>
+    std::string sorted_path(std::string const& path, Less less, external_options const& options, std::vector<temp_path>& temps)
+    {
+      {
+        mapped_file<T> f{path, options.window};
+        if (std::is_sorted(begin(f), end(f), less)) { return path; }
+      }
+      temps.emplace_back(options.tmp_dir);
+      external_sort<T>(path, temps.back().path, less, options);
+      return temps.back().path;
+    }
+  }
+
+
+  // my::join of two files of records. less1 and less2 order each file on its own (the heterogeneous cmp only
+  // compares a T1 with a T2): they check that a file is sorted, and sort it if it isn't.
+  template <typename T1, typename T2, typename Less1, typename Less2, typename OutIterator, typename Comparator, typename Combiner>
+  OutIterator external_join(std::string const& path1, Less1 less1,
+                            std::string const& path2, Less2 less2,
+                            OutIterator out_it,
+                            Comparator cmp,
+                            Combiner&& comb,
+                            external_options const& options = {})
+  {
+    std::vector<detail::temp_path> temps;
+    temps.reserve(2);
+    std::string const p1 = detail::sorted_path<T1>(path1, less1, options, temps);
+    std::string const p2 = detail::sorted_path<T2>(path2, less2, options, temps);
+
+    mapped_file<T1> f1{p1, options.window};
+    mapped_file<T2> f2{p2, options.window};
+    return my::join(begin(f1), end(f1), begin(f2), end(f2), out_it, cmp, std::forward<Combiner>(comb));
+  }
+}
+
+
+
+
+
+struct S
+{
+   explicit S(int id_, int v_) : id{id_}, v{v_} {}
+   int id;
+   int v;
+};
+
+
+struct M
+{
+   explicit M(int id_, int v_) : id{id_}, v{v_} {}
+   int id;
+   int v;
+};
+
+std::ostream& operator<<(std::ostream& os, S s) { return os << "S{" << s.id << ", " << s.v << "}"; }
+std::ostream& operator<<(std::ostream& os, M m) { return os << "M{" << m.id << ", " << m.v << "}"; }
+
+struct cmp
+{
+    bool operator()(S s, M m) { return s.id < m.id; }
+    bool operator()(M m, S s) { return m.id < s.id; }
+};
+
+
+template <typename T>
+void write_file(std::string const& path, std::vector<T> const& v)
+{
+    my::detail::file{path, O_WRONLY | O_CREAT | O_TRUNC}.write(v.data(), v.size() * sizeof(T));
+}
+
+
+int main()
+{
+    // Two unsorted files of 4M records (32MB each), joined with a 1MB budget: 64 runs of 512KB per file,
+    // merged 15 at a time, so two merge passes.
+    constexpr std::size_t n = 4'000'000;
+    std::mt19937 gen{23};
+    std::uniform_int_distribution<int> pick{0, static_cast<int>(n)};
+    std::vector<M> ms;
+    std::vector<S> ss;
+    ms.reserve(n);
+    ss.reserve(n);
+    for (std::size_t i{0}; i < n; ++i) { ms.emplace_back(pick(gen), static_cast<int>(i)); }
+    for (std::size_t i{0}; i < n; ++i) { ss.emplace_back(pick(gen), static_cast<int>(i)); }
+
+    my::detail::temp_path m_path{"/tmp"}, s_path{"/tmp"};
+    write_file(m_path.path, ms);
+    write_file(s_path.path, ss);
+
+    auto by_m = [](M const& x, M const& y) { return x.id < y.id; };
+    auto by_s = [](S const& x, S const& y) { return x.id < y.id; };
+    auto checksum = [](M const& m, S const& s) { return static_cast<std::uint64_t>(m.v) * 31 + static_cast<std::uint64_t>(s.v); };
+
+    // the reference, in memory.
+    std::sort(ms.begin(), ms.end(), by_m);
+    std::sort(ss.begin(), ss.end(), by_s);
+    std::uint64_t expected_sum{0};
+    std::size_t expected{0};
+    struct sum_iterator
+    {
+        std::uint64_t* sum; std::size_t* count;
+        sum_iterator& operator*() { return *this; }
+        sum_iterator& operator++() { return *this; }
+        sum_iterator operator++(int) { return *this; }
+        sum_iterator& operator=(std::uint64_t x) { *sum += x; ++*count; return *this; }
+    };
+    my::join(ms.cbegin(), ms.cend(), ss.cbegin(), ss.cend(), sum_iterator{&expected_sum, &expected}, cmp{}, checksum);
+    ms = {};
+    ss = {};
+
+    my::external_options options;
+    options.memory_budget = std::size_t(1) << 20;
+    options.merge_buffer = std::size_t(64) << 10;
+    options.window = std::size_t(4) << 20;
+
+    std::uint64_t sum{0};
+    std::size_t count{0};
+    auto start = std::chrono::steady_clock::now();
+    my::external_join<M, S>(m_path.path, by_m, s_path.path, by_s, sum_iterator{&sum, &count}, cmp{}, checksum, options);
+    auto ms_taken = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "external join: " << count << " pairs in " << ms_taken << "ms"
+              << ((sum == expected_sum) && (count == expected) ? ", same as in memory" : ", DIFFERENT") << '\n';
+}
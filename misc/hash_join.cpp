@@ -0,0 +1,496 @@
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <vector>
+#include <forward_list>
+#include <iterator>
+#include <type_traits>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+#include <chrono>
+#include <random>
+#include <unistd.h>
+
+// my::join (set_intersection.cpp) needs both inputs sorted on the key. On an unsorted feed that we join
+// once, the sort is O(n log n) for an O(n) join.
+//
+// A hash join does not care about the order: put the smaller input (the build side) in a hash table, and
+// look every element of the other input (the probe side) up in it. The catch is that a big hash table is a
+// cache miss per probe. So both sides are radix partitioned first, on the low bits of the hash, into
+// partitions whose hash table fits in the L2 cache; then partition p of the probe side only probes the
+// (small) table of partition p of the build side.
+//
+// A hash needs a key, not only an order: the comparator of my::join is replaced by a key extractor, with
+// one overload per side (like the heterogeneous comparator). The Combiner is the same: comb(a, b).
+//
+// my::planned_join picks the algorithm:
+//   - both sides sorted: the merge join, nothing to prepare,
+//   - otherwise the hash join, if its partitions fit in the memory budget and it's cheaper than sorting
+//     the unsorted side(s) (a small unsorted side is cheaper to sort than to hash everything),
+//   - otherwise sort (an index, not the data) and merge.
+// The hash join emits the same pairs as my::join, but not in the same order.
+
+namespace my
+{
+
+  template <typename Iterator1, typename Iterator2, typename OutIterator, typename Comparator,
+            typename Combiner
+            >
+  OutIterator join(Iterator1 first1, Iterator1 last1,
+                               Iterator2 first2, Iterator2 last2,
+                               OutIterator out_it,
+                               Comparator cmp,
+                               Combiner&& comb)
+  {
+
+    for (auto fixed_f2=first2 ; (first1 != last1) && (fixed_f2 != last2) ; )
+    {
+         if      ((first2 == last2) || cmp(*first1, *first2)) { first1++; first2 = fixed_f2;}
+         else if (cmp(*first2, *first1)) { first2++; fixed_f2 = first2; }
+         else                            { *out_it++ = comb(*first1, *first2++); }
+    }
+    return out_it;
+  }
+
+
+  namespace detail
+  {
+    // std::hash of an int is the int itself on common implementations, and its low bits would make poor
+    // partitions. This mixes every bit into every other (the finalizer of murmur3).
+    inline std::uint64_t mix(std::uint64_t h)
+    {
+      h ^= h >> 33;  h *= 0xff51afd7ed558ccdULL;
+      h ^= h >> 33;  h *= 0xc4ceb9fe1a85ec53ULL;
+      h ^= h >> 33;
+      return h;
+    }
+
+    template <typename Key, typename T>
+    std::uint64_t hash_of(Key& key, T const& t)
+    {
+      using key_t = std::decay_t<decltype(key(t))>;
+      return mix(std::hash<key_t>{}(key(t)));
+    }
+
+    // Rows of a build partition per L2 sized hash table (~256KB, 16 bytes per row with its chain link).
+    constexpr std::size_t cache_rows = 16 * 1024;
+    constexpr unsigned max_radix_bits = 14;
+
+    inline unsigned radix_bits_for(std::size_t build_rows)
+    {
+      unsigned bits{0};
+      while (((build_rows >> bits) > cache_rows) && (bits < max_radix_bits)) { ++bits; }
+      return bits;
+    }
+
+    struct row
+    {
+      std::uint64_t hash;
+      std::size_t index;   // position in the input
+    };
+
+    // One pass of radix partitioning: histogram, prefix sum, scatter.
+    // Returns the rows grouped by partition, and where every partition starts (bounds[p] .. bounds[p+1]).
+    template <typename Iterator, typename Key>
+    std::vector<row> radix_partition(Iterator first, std::size_t n, Key& key, unsigned bits, std::vector<std::size_t>& bounds)
+    {
+      std::size_t const partitions = std::size_t(1) << bits;
+      std::uint64_t const mask = partitions - 1;
+
+      std::vector<std::uint64_t> hashes(n);
+      bounds.assign(partitions + 1, 0);
+      for (std::size_t i{0}; i < n; ++i)
+      {
+        hashes[i] = hash_of(key, first[i]);
+        ++bounds[(hashes[i] & mask) + 1];
+      }
+      for (std::size_t p{0}; p < partitions; ++p) { bounds[p + 1] += bounds[p]; }
+
+      std::vector<row> rows(n);
+      std::vector<std::size_t> fill(bounds.begin(), bounds.end() - 1);
+      for (std::size_t i{0}; i < n; ++i) { rows[fill[hashes[i] & mask]++] = row{hashes[i], i}; }
+      return rows;
+    }
+
+    // The bytes the hash join needs on top of its inputs.
+    inline std::size_t hash_join_bytes(std::size_t n1, std::size_t n2)
+    {
+      std::size_t const build = std::min(n1, n2);
+      return (n1 + n2) * (sizeof(row) + sizeof(std::uint64_t))                // hashes + partitioned rows
+           + std::min(build, cache_rows) * 3 * sizeof(std::uint32_t);         // one partition's head + next
+    }
+
+    template <typename Iterator>
+    constexpr bool is_random_access_v =
+        std::is_base_of_v<std::random_access_iterator_tag, typename std::iterator_traits<Iterator>::iterator_category>;
+  }
+
+
+  // Every pair (a, b) with key(a) == key(b), as comb(a, b). The inputs can be in any order.
+  template <typename Iterator1, typename Iterator2, typename OutIterator, typename Key,
+            typename Combiner
+            >
+  OutIterator hash_join(Iterator1 first1, Iterator1 last1,
+                        Iterator2 first2, Iterator2 last2,
+                        OutIterator out_it,
+                        Key key,
+                        Combiner&& comb)
+  {
+    static_assert(detail::is_random_access_v<Iterator1> && detail::is_random_access_v<Iterator2>,
+                  "the partitions refer to the inputs by index: random access iterators");
+
+    auto const n1 = static_cast<std::size_t>(last1 - first1);
+    auto const n2 = static_cast<std::size_t>(last2 - first2);
+
+    // The smaller side is the build side; the arguments of comb keep their order either way.
+    auto run = [&](auto build, std::size_t nb, auto probe, std::size_t np, auto emit)
+    {
+      unsigned const bits = detail::radix_bits_for(nb);
+      std::vector<std::size_t> build_bounds, probe_bounds;
+      auto const build_rows = detail::radix_partition(build, nb, key, bits, build_bounds);
+      auto const probe_rows = detail::radix_partition(probe, np, key, bits, probe_bounds);
+
+      // The table of a partition: chained, in arrays. head[bucket] and next[row] are 1 based, 0 ends a chain.
+      // Allocated once for the biggest partition, then reused.
+      std::vector<std::uint32_t> head;
+      std::vector<std::uint32_t> next;
+
+      for (std::size_t p{0}; p + 1 < build_bounds.size(); ++p)
+      {
+        std::size_t const b0 = build_bounds[p], b1 = build_bounds[p + 1];
+        std::size_t const p0 = probe_bounds[p], p1 = probe_bounds[p + 1];
+        if ((b0 == b1) || (p0 == p1)) { continue; }
+
+        std::size_t buckets{1};
+        while (buckets < 2 * (b1 - b0)) { buckets *= 2; }
+        head.assign(buckets, 0);
+        next.resize(b1 - b0);
+
+        // the bits below `bits` are the same in the whole partition: use the ones above.
+        // Inserted backwards, so a chain lists the build rows in input order.
+        for (std::size_t r{b1}; r-- > b0; )
+        {
+          std::size_t const bucket = (build_rows[r].hash >> bits) & (buckets - 1);
+          next[r - b0] = head[bucket];
+          head[bucket] = static_cast<std::uint32_t>(r - b0 + 1);
+        }
+
+        for (std::size_t r{p0}; r < p1; ++r)
+        {
+          auto const& pr = probe_rows[r];
+          auto const& pv = probe[pr.index];
+          for (auto k = head[(pr.hash >> bits) & (buckets - 1)]; k != 0; k = next[k - 1])
+          {
+            auto const& br = build_rows[b0 + k - 1];
+            if ((br.hash == pr.hash) && (key(build[br.index]) == key(pv))) { emit(build[br.index], pv); }
+          }
+        }
+      }
+    };
+
+    if (n1 <= n2)
+    {
+      run(first1, n1, first2, n2, [&](auto const& a, auto const& b) { *out_it++ = comb(a, b); });
+    }
+    else
+    {
+      run(first2, n2, first1, n1, [&](auto const& b, auto const& a) { *out_it++ = comb(a, b); });
+    }
+    return out_it;
+  }
+
+
+  enum class join_plan { merge, sort_merge, hash };
+
+  inline char const* to_string(join_plan p)
+  {
+    switch (p)
+    {
+      case join_plan::merge:      return "merge";
+      case join_plan::sort_merge: return "sort + merge";
+      case join_plan::hash:       return "hash";
+    }
+    return "?";
+  }
+
+  // Half of the memory that is free right now.
+  inline std::size_t default_memory_budget()
+  {
+    long const pages = sysconf(_SC_AVPHYS_PAGES);
+    long const page_size = sysconf(_SC_PAGESIZE);
+    if ((pages <= 0) || (page_size <= 0)) { return std::size_t(1) << 30; }
+    return static_cast<std::size_t>(pages) * static_cast<std::size_t>(page_size) / 2;
+  }
+
+  namespace detail
+  {
+    template <typename Iterator, typename Key>
+    bool is_sorted_on(Iterator first, Iterator last, Key& key)
+    {
+      return std::is_sorted(first, last, [&](auto const& x, auto const& y) { return key(x) < key(y); });
+    }
+
+    inline double sort_cost(std::size_t n)
+    {
+      double l{1};
+      for (std::size_t m{n}; m > 1; m /= 2) { l += 1; }
+      return static_cast<double>(n) * l;
+    }
+
+    // A hashed row costs about as much as this many comparisons in a sort (hash, two scatters, a probe that
+    // often misses L1). Measured with the benchmark in main.
+    constexpr double hash_cost_per_row = 6.0;
+  }
+
+  namespace detail
+  {
+    struct join_choice
+    {
+      join_plan plan;
+      bool sorted1;
+      bool sorted2;
+    };
+
+    // The hash join refers to the inputs by index: only with random access iterators.
+    template <typename Iterator1, typename Iterator2, typename Key>
+    join_choice choose(Iterator1 first1, Iterator1 last1,
+                       Iterator2 first2, Iterator2 last2,
+                       Key& key,
+                       std::size_t memory_budget)
+    {
+      bool const sorted1 = is_sorted_on(first1, last1, key);
+      bool const sorted2 = is_sorted_on(first2, last2, key);
+      if (sorted1 && sorted2) { return {join_plan::merge, true, true}; }
+
+      if constexpr (is_random_access_v<Iterator1> && is_random_access_v<Iterator2>)
+      {
+        auto const n1 = static_cast<std::size_t>(last1 - first1);
+        auto const n2 = static_cast<std::size_t>(last2 - first2);
+        double const sort_merge = (sorted1 ? 0.0 : sort_cost(n1)) + (sorted2 ? 0.0 : sort_cost(n2)) + (n1 + n2);
+        double const hash = hash_cost_per_row * (n1 + n2);
+        if ((hash < sort_merge) && (hash_join_bytes(n1, n2) <= memory_budget)) { return {join_plan::hash, sorted1, sorted2}; }
+      }
+      return {join_plan::sort_merge, sorted1, sorted2};
+    }
+
+    // The iterators of a range, as a range: *it is the underlying iterator. The sort + merge plan joins
+    // ranges of iterators; a side that is already sorted goes through this, without copying anything.
+    template <typename Iterator>
+    class iterator_of
+    {
+    public:
+      using value_type        = Iterator;
+      using reference         = Iterator;
+      using pointer           = void;
+      using difference_type   = typename std::iterator_traits<Iterator>::difference_type;
+      using iterator_category = std::forward_iterator_tag;
+
+      iterator_of() = default;
+      explicit iterator_of(Iterator it_) : it{it_} {}
+
+      Iterator operator*() const { return it; }
+      iterator_of& operator++() { ++it; return *this; }
+      iterator_of operator++(int) { auto tmp = *this; ++it; return tmp; }
+
+      friend bool operator==(iterator_of const& x, iterator_of const& y) { return x.it == y.it; }
+      friend bool operator!=(iterator_of const& x, iterator_of const& y) { return x.it != y.it; }
+
+    private:
+      Iterator it{};
+    };
+  }
+
+  template <typename Iterator1, typename Iterator2, typename Key>
+  join_plan choose_join(Iterator1 first1, Iterator1 last1,
+                        Iterator2 first2, Iterator2 last2,
+                        Key key,
+                        std::size_t memory_budget)
+  {
+    return detail::choose(first1, last1, first2, last2, key, memory_budget).plan;
+  }
+
+
+  // Joins with the plan of choose_join. Returns the plan, so the caller can tell.
+  // With forward iterators, the plan is never hash.
+  template <typename Iterator1, typename Iterator2, typename OutIterator, typename Key,
+            typename Combiner
+            >
+  join_plan planned_join(Iterator1 first1, Iterator1 last1,
+                         Iterator2 first2, Iterator2 last2,
+                         OutIterator out_it,
+                         Key key,
+                         Combiner&& comb,
+                         std::size_t memory_budget = default_memory_budget())
+  {
+    auto const choice = detail::choose(first1, last1, first2, last2, key, memory_budget);
+
+    if (choice.plan == join_plan::merge)
+    {
+      // my::join takes a comparator: the one of the key.
+      my::join(first1, last1, first2, last2, out_it, [&](auto const& x, auto const& y) { return key(x) < key(y); }, comb);
+    }
+    else if (choice.plan == join_plan::hash)
+    {
+      if constexpr (detail::is_random_access_v<Iterator1> && detail::is_random_access_v<Iterator2>)
+      {
+        my::hash_join(first1, last1, first2, last2, out_it, key, comb);
+      }
+    }
+    else
+    {
+      // The inputs are not ours to sort: an unsorted side is joined through a sorted vector of its
+      // iterators, a sorted side through iterator_of (no copy). Either way the elements are iterators.
+      auto by_key = [&](auto x, auto y) { return key(*x) < key(*y); };
+      auto by_comb = [&](auto x, auto y) { return comb(*x, *y); };
+      auto index = [&](auto first, auto last)
+      {
+        std::vector<decltype(first)> its;
+        its.reserve(static_cast<std::size_t>(std::distance(first, last)));
+        for (auto it = first; it != last; ++it) { its.push_back(it); }
+        std::stable_sort(its.begin(), its.end(), by_key);
+        return its;
+      };
+      using it1 = detail::iterator_of<Iterator1>;
+      using it2 = detail::iterator_of<Iterator2>;
+
+      if (choice.sorted1)
+      {
+        auto const i2 = index(first2, last2);
+        my::join(it1{first1}, it1{last1}, i2.begin(), i2.end(), out_it, by_key, by_comb);
+      }
+      else if (choice.sorted2)
+      {
+        auto const i1 = index(first1, last1);
+        my::join(i1.begin(), i1.end(), it2{first2}, it2{last2}, out_it, by_key, by_comb);
+      }
+      else
+      {
+        auto const i1 = index(first1, last1);
+        auto const i2 = index(first2, last2);
+        my::join(i1.begin(), i1.end(), i2.begin(), i2.end(), out_it, by_key, by_comb);
+      }
+    }
+    return choice.plan;
+  }
+}
+
+
+
+
+
+struct S
+{
+   explicit S(int id_, int v_) : id{id_}, v{v_} {}
+   int id;
+   int v;
+};
+
+
+struct M
+{
+   explicit M(int id_, int v_) : id{id_}, v{v_} {}
+   int id;
+   int v;
+};
+
+std::ostream& operator<<(std::ostream& os, S s) { return os << "S{" << s.id << ", " << s.v << "}"; }
+std::ostream& operator<<(std::ostream& os, M m) { return os << "M{" << m.id << ", " << m.v << "}"; }
+
+// The hash join counterpart of the heterogeneous comparator: the key of either side.
+struct key
+{
+    int operator()(S const& s) const { return s.id; }
+    int operator()(M const& m) const { return m.id; }
+};
+
+
+int main()
+{
+    // The example of set_intersection.cpp: both sides sorted, the planner merges.
+    std::vector<M> A{M{2,2},M{2,3}, M{5,5}};
+    std::vector<S> B{S{2,1},S{2,4}};
+    std::vector<std::string> C;
+
+    auto comb = [](M const& m, S const& s)
+    {
+        std::ostringstream os;
+        os <<  m << "-" << s;
+        return os.str();
+    };
+
+    auto plan = my::planned_join(std::cbegin(A), std::cend(A), std::cbegin(B), std::cend(B), std::back_inserter(C), key{}, comb);
+    std::cout << my::to_string(plan) << ": ";  for (auto c: C) { std::cout << c << ' '; } std::cout << '\n';
+    // This prints: merge: M{2, 2}-S{2, 1} M{2, 2}-S{2, 4} M{2, 3}-S{2, 1} M{2, 3}-S{2, 4}
+
+
+    // Unsorted feeds, with duplicate keys.
+    constexpr std::size_t n = 5'000'000;
+    std::mt19937 gen{11};
+    std::uniform_int_distribution<int> pick{0, static_cast<int>(n)};
+    std::vector<M> feed_m;
+    std::vector<S> feed_s;
+    feed_m.reserve(n);
+    feed_s.reserve(n);
+    for (std::size_t i{0}; i < n; ++i) { feed_m.emplace_back(pick(gen), static_cast<int>(i)); }
+    for (std::size_t i{0}; i < n; ++i) { feed_s.emplace_back(pick(gen), static_cast<int>(i)); }
+
+    auto pair_comb = [](M const& m, S const& s) { return std::pair{m.v, s.v}; };
+
+    auto time = [](auto f)
+    {
+        auto start = std::chrono::steady_clock::now();
+        auto r = f();
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+        return std::pair{std::move(r), us};
+    };
+
+    auto [hashed, t_hash] = time([&]()
+    {
+        std::vector<std::pair<int, int>> out;
+        my::hash_join(feed_m.cbegin(), feed_m.cend(), feed_s.cbegin(), feed_s.cend(), std::back_inserter(out), key{}, pair_comb);
+        return out;
+    });
+
+    auto [sorted, t_sort] = time([&]()
+    {
+        // what we do today: copy, sort both, merge.
+        auto m = feed_m;
+        auto s = feed_s;
+        std::sort(m.begin(), m.end(), [](M const& x, M const& y) { return x.id < y.id; });
+        std::sort(s.begin(), s.end(), [](S const& x, S const& y) { return x.id < y.id; });
+        std::vector<std::pair<int, int>> out;
+        my::join(m.cbegin(), m.cend(), s.cbegin(), s.cend(), std::back_inserter(out),
+                 [](auto const& x, auto const& y) { return key{}(x) < key{}(y); }, pair_comb);
+        return out;
+    });
+
+    std::vector<std::pair<int, int>> planned;
+    auto [p, t_planned] = time([&]()
+    {
+        return my::planned_join(feed_m.cbegin(), feed_m.cend(), feed_s.cbegin(), feed_s.cend(), std::back_inserter(planned), key{}, pair_comb);
+    });
+
+    std::sort(hashed.begin(), hashed.end());
+    std::sort(sorted.begin(), sorted.end());
+    std::sort(planned.begin(), planned.end());
+    std::cout << "sort + merge: " << sorted.size() << " pairs in " << t_sort << "us\n";
+    std::cout << "hash join:    " << hashed.size() << " pairs in " << t_hash << "us"
+              << (hashed == sorted ? "" : " (DIFFERENT)") << '\n';
+    std::cout << "planned (" << my::to_string(p) << "): " << planned.size() << " pairs in " << t_planned << "us"
+              << (planned == sorted ? "" : " (DIFFERENT)") << '\n';
+
+    // A tiny unsorted side against a big sorted one: sorting 1000 keys beats hashing 5M.
+    std::vector<S> few(feed_s.begin(), feed_s.begin() + 1000);
+    std::vector<M> big_sorted = feed_m;
+    std::sort(big_sorted.begin(), big_sorted.end(), [](M const& x, M const& y) { return x.id < y.id; });
+    std::cout << "1k unsorted x 5M sorted: " << my::to_string(my::choose_join(big_sorted.cbegin(), big_sorted.cend(), few.cbegin(), few.cend(), key{}, my::default_memory_budget())) << '\n';
+    std::cout << "with a 1MB budget:       " << my::to_string(my::choose_join(feed_m.cbegin(), feed_m.cend(), feed_s.cbegin(), feed_s.cend(), key{}, 1 << 20)) << '\n';
+
+    // Forward iterators: no hash join, a sorted side is merged as it is, an unsorted one through an index.
+    std::forward_list<M> list_m{M{5,5}, M{2,2}, M{2,3}};
+    C.clear();
+    plan = my::planned_join(list_m.cbegin(), list_m.cend(), std::cbegin(B), std::cend(B), std::back_inserter(C), key{}, comb);
+    std::cout << my::to_string(plan) << ": ";  for (auto c: C) { std::cout << c << ' '; } std::cout << '\n';
+    // This prints: sort + merge: M{2, 2}-S{2, 1} M{2, 2}-S{2, 4} M{2, 3}-S{2, 1} M{2, 3}-S{2, 4}
+}
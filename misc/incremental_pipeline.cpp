@@ -0,0 +1,317 @@
+#include <iostream>
+#include <utility>
+#include <type_traits>
+#include <tuple>
+#include <array>
+#include <cstdint>
+
+// When A1 gets new data, rebuilding the whole pipeline redoes every stage, even the ones that
+// never look at A1. Here every stage output carries a version stamp:
+//   - update<A1>(f) changes A1, bumps its version, and marks A1's transitive dependents dirty.
+//   - evaluate() walks the (compile time) topological order and only looks at dirty stages.
+//     A dirty stage is recomputed only if one of its inputs has a newer version than the one it saw
+//     last time. If the recomputed output compares equal to the old one, its version is not bumped,
+//     and the stages below it stop there too (early cut off).
+
+template <typename... Args>
+struct types_list {};
+
+
+namespace detail
+{
+
+template <typename T, typename TypeList>
+struct type_exists;
+
+template <typename T, typename... Args>
+struct type_exists<T, types_list<Args...>> : std::bool_constant<(std::is_same_v<T, Args> || ...)> {};
+
+template <typename T, typename TypeList>
+constexpr bool type_exists_v = type_exists<T, TypeList>::value;
+
+
+template <typename T, typename TypeList>
+struct append;
+
+template <typename T, typename... Args>
+struct append<T, types_list<Args...>>
+{
+    using type = types_list<Args..., T>;
+};
+
+
+template <typename T, typename Path, typename Done, bool already_done = type_exists_v<T, Done>>
+struct visit;
+
+template <typename Deps, typename Path, typename Done>
+struct visit_all;
+
+template <typename T, typename Path, typename Done>
+struct visit<T, Path, Done, true>
+{
+    using type = Done;
+};
+
+template <typename T, typename... Path, typename Done>
+struct visit<T, types_list<Path...>, Done, false>
+{
+    static constexpr bool is_cycle = type_exists_v<T, types_list<Path...>>;
+    static_assert(!is_cycle, "depends_on has a cycle");
+
+    using deps = std::conditional_t<is_cycle, std::tuple<>, typename T::depends_on>;
+    using deps_done = typename visit_all<deps, types_list<Path..., T>, Done>::type;
+    using type = typename append<T, deps_done>::type;
+};
+
+template <typename Path, typename Done>
+struct visit_all<std::tuple<>, Path, Done>
+{
+    using type = Done;
+};
+
+template <typename D, typename... Ds, typename Path, typename Done>
+struct visit_all<std::tuple<D, Ds...>, Path, Done>
+{
+    using type = typename visit_all<std::tuple<Ds...>, Path, typename visit<D, Path, Done>::type>::type;
+};
+
+}
+
+template <typename... Ts>
+using topological_order_t = typename detail::visit_all<std::tuple<Ts...>, types_list<>, types_list<>>::type;
+
+
+namespace detail
+{
+    template <typename Deps, typename... Ts>
+    struct depends_row;
+
+    template <typename... Ds, typename... Ts>
+    struct depends_row<std::tuple<Ds...>, Ts...>
+    {
+        static constexpr std::array<bool, sizeof...(Ts)> value{type_exists_v<Ts, types_list<Ds...>>...};
+    };
+
+    // depends[i][j]: stage j is in the depends_on of stage i.
+    template <typename... Ts>
+    constexpr std::array<std::array<bool, sizeof...(Ts)>, sizeof...(Ts)> depends_matrix()
+    {
+        return {depends_row<typename Ts::depends_on, Ts...>::value...};
+    }
+
+    // affects[j][i]: a change in stage j reaches stage i (j itself included).
+    // The stages are in topological order, so a single forward pass closes the relation.
+    template <typename... Ts>
+    constexpr std::array<std::array<bool, sizeof...(Ts)>, sizeof...(Ts)> affects_matrix()
+    {
+        constexpr std::size_t n = sizeof...(Ts);
+        constexpr auto depends = depends_matrix<Ts...>();
+        std::array<std::array<bool, n>, n> affects{};
+        for (std::size_t j{0}; j < n; ++j)
+        {
+            affects[j][j] = true;
+            for (std::size_t i{j+1}; i < n; ++i)
+            {
+                for (std::size_t k{j}; k < i; ++k)
+                {
+                    if (affects[j][k] && depends[i][k]) { affects[j][i] = true; }
+                }
+            }
+        }
+        return affects;
+    }
+
+    template <typename T, typename = void>
+    struct is_equality_comparable : std::false_type {};
+
+    template <typename T>
+    struct is_equality_comparable<T, std::void_t<decltype(std::declval<T const&>() == std::declval<T const&>())>>
+        : std::true_type {};
+
+    template <typename T>
+    struct type_tag { using type = T; };
+
+    template <typename Tuple>
+    struct tags_of;
+
+    template <typename... Ds>
+    struct tags_of<std::tuple<Ds...>>
+    {
+        using type = std::tuple<type_tag<Ds>...>;
+    };
+
+    template <typename Tuple>
+    using tags_of_t = typename tags_of<Tuple>::type;
+
+    template <typename T, typename... Ts>
+    struct index_of : std::integral_constant<std::size_t, 0> {};
+
+    template <typename T, typename F, typename... Ts>
+    struct index_of<T, F, Ts...>
+        : std::integral_constant<std::size_t, std::is_same_v<T, F> ? 0 : 1 + index_of<T, Ts...>::value> {};
+}
+
+
+template <typename TypeList>
+class incremental_pipeline;
+
+template <typename... Ts>
+class incremental_pipeline<types_list<Ts...>>
+{
+public:
+    static constexpr std::size_t N = sizeof...(Ts);
+    static constexpr auto depends = detail::depends_matrix<Ts...>();
+    static constexpr auto affects = detail::affects_matrix<Ts...>();
+
+    template <typename T>
+    static constexpr std::size_t index_v = detail::index_of<T, Ts...>::value;
+
+    // Everything starts dirty; the first evaluate() is a full build.
+    incremental_pipeline() { dirty.fill(true); }
+
+    template <typename T>
+    T const& get() const { return std::get<T>(stages); }
+
+    // Change a stage from the outside (usually an input, i.e. a stage with an empty depends_on).
+    template <typename T, typename F>
+    void update(F f)
+    {
+        constexpr std::size_t i = index_v<T>;
+        f(std::get<i>(stages));
+        version[i] = ++clock;
+        for (std::size_t k{0}; k < N; ++k)
+        {
+            if (affects[i][k] && (k != i)) { dirty[k] = true; }
+        }
+    }
+
+    // Returns how many stages were recomputed.
+    std::size_t evaluate()
+    {
+        std::size_t recomputed{0};
+        evaluate(recomputed, std::index_sequence_for<Ts...>{});
+        return recomputed;
+    }
+
+private:
+    template <std::size_t... Is>
+    void evaluate(std::size_t& recomputed, std::index_sequence<Is...>)
+    {
+        // topological order: when we get to stage i, its inputs are up to date.
+        (evaluate_one<Is>(recomputed), ...);
+    }
+
+    template <std::size_t I>
+    void evaluate_one(std::size_t& recomputed)
+    {
+        if (!dirty[I]) { return; }
+        dirty[I] = false;
+
+        // dirty only means "maybe". Did an input really change since the last run?
+        bool inputs_changed = (version[I] == 0);
+        for (std::size_t j{0}; j < N; ++j)
+        {
+            if (depends[I][j] && (seen[I][j] != version[j])) { inputs_changed = true; }
+            seen[I][j] = version[j];
+        }
+        if (!inputs_changed) { return; }
+
+        ++recomputed;
+        auto& stage = std::get<I>(stages);
+        using T = std::decay_t<decltype(stage)>;
+
+        if constexpr (detail::is_equality_comparable<T>::value)
+        {
+            T const old = stage;
+            run_one(stage);
+            if ((version[I] != 0) && (stage == old)) { return; } // early cut off.
+        }
+        else
+        {
+            run_one(stage);
+        }
+        version[I] = ++clock;
+    }
+
+    template <typename T>
+    void run_one(T& stage)
+    {
+        std::apply([&](auto... d) { stage.run(std::get<typename decltype(d)::type>(stages)...); },
+                   detail::tags_of_t<typename T::depends_on>{});
+    }
+
+    std::tuple<Ts...> stages;
+
+    // version 0 means "never computed".
+    std::uint64_t clock{0};
+    std::array<std::uint64_t, N> version{};
+    std::array<std::array<std::uint64_t, N>, N> seen{};   // seen[i][j]: version of j when i last ran.
+    std::array<bool, N> dirty{};
+};
+
+template <typename... Ts>
+using incremental_pipeline_for = incremental_pipeline<topological_order_t<Ts...>>;
+
+
+// A1 and A2 are the inputs. B2 only keeps the sign of A2, so most changes in A2 stop at B2.
+struct A1
+{
+    using depends_on = std::tuple<>;
+    void run() {}
+    int value{1};
+};
+
+struct A2
+{
+    using depends_on = std::tuple<>;
+    void run() {}
+    int value{2};
+};
+
+struct B1
+{
+    using depends_on = std::tuple<A1>;
+    void run(A1 const& a) { std::cout << "  running B1\n"; value = a.value * 10; }
+    bool operator==(B1 const& o) const { return value == o.value; }
+    int value{0};
+};
+
+struct B2
+{
+    using depends_on = std::tuple<A2>;
+    void run(A2 const& a) { std::cout << "  running B2\n"; positive = a.value > 0; }
+    bool operator==(B2 const& o) const { return positive == o.positive; }
+    bool positive{false};
+};
+
+struct C1
+{
+    using depends_on = std::tuple<B1, B2>;
+    void run(B1 const& b1, B2 const& b2) { std::cout << "  running C1\n"; value = b2.positive ? b1.value : -b1.value; }
+    int value{0};
+};
+
+
+int main()
+{
+    incremental_pipeline_for<C1> pipeline;
+
+    auto report = [&](char const* what)
+    {
+        std::cout << what << '\n';
+        std::size_t n = pipeline.evaluate();
+        std::cout << "  -> " << n << " stage(s), C1 = " << pipeline.get<C1>().value << '\n';
+    };
+
+    report("full build");                                           // B1 B2 C1 (+ the inputs): 5, C1 = 10
+    report("nothing changed");                                      // 0
+
+    pipeline.update<A1>([](A1& a) { a.value = 4; });
+    report("A1 changed");                                           // B1 C1: 2, C1 = 40
+
+    pipeline.update<A2>([](A2& a) { a.value = 7; });
+    report("A2 changed, same sign");                                // B2 only: 1
+
+    pipeline.update<A2>([](A2& a) { a.value = -7; });
+    report("A2 changed sign");                                      // B2 C1: 2, C1 = -40
+}
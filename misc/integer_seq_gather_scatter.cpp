@@ -0,0 +1,214 @@
+#include <iostream>
+#include <type_traits>
+#include <array>
+#include <utility>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// In concat_integer_seq.cpp, f(arr, integer_seq<N...>) picks elements of an array at compile time,
+// but all it does is printing them. Let's turn it into something useful:
+//
+//   gather <N...>(src)      : returns {src[N]...}
+//   scatter<N...>(src, dst) : dst[N_k] = src[k]
+//   permute<N...>(src)      : a gather where N... is a permutation of [0, size)
+//
+// The indices are checked at compile time. When the pattern fits in one register (4 or 8 lanes
+// of 32 bits) we use a single shuffle, otherwise the fold expression gives us unrolled scalar moves.
+
+template <std::size_t... N>
+struct integer_seq
+{
+};
+
+
+namespace detail
+{
+    template <std::size_t size, std::size_t... N>
+    constexpr bool all_in_range() { return ((N < size) && ...); }
+
+    template <std::size_t... N>
+    constexpr bool all_unique()
+    {
+        constexpr std::size_t ns[] = {N..., 0};  // the extra 0 makes the empty pack legal.
+        for (std::size_t i{0}; i < sizeof...(N); ++i)
+        {
+            for (std::size_t j{i+1}; j < sizeof...(N); ++j)
+            {
+                if (ns[i] == ns[j]) { return false; }
+            }
+        }
+        return true;
+    }
+
+    // The SSE/AVX shuffles move 32 bit lanes; they don't care about the type in the lane.
+    template <typename T>
+    constexpr bool is_lane_32_v = (sizeof(T) == 4) && std::is_trivially_copyable_v<T>;
+
+    // _mm_shuffle_epi32 takes its pattern as an immediate: 2 bits per lane.
+    template <std::size_t N0, std::size_t N1, std::size_t N2, std::size_t N3>
+    constexpr int shuffle_imm = static_cast<int>(N0 | (N1 << 2) | (N2 << 4) | (N3 << 6));
+
+
+    // The generic version: one move per index.
+    template <typename T, std::size_t size, std::size_t... N>
+    struct gather
+    {
+        static std::array<T, sizeof...(N)> apply(std::array<T, size> const& src)
+        {
+            return {src[N]...};
+        }
+    };
+
+#if defined(__SSE2__)
+    // 4 x 32 bits from a 4 x 32 bits source: one pshufd.
+    template <typename T, std::size_t N0, std::size_t N1, std::size_t N2, std::size_t N3>
+    struct gather<T, 4, N0, N1, N2, N3>
+    {
+        static std::array<T, 4> apply(std::array<T, 4> const& src)
+        {
+            if constexpr (is_lane_32_v<T>)
+            {
+                std::array<T, 4> dst;
+                __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src.data()));
+                v = _mm_shuffle_epi32(v, (shuffle_imm<N0, N1, N2, N3>));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst.data()), v);
+                return dst;
+            }
+            else
+            {
+                return {src[N0], src[N1], src[N2], src[N3]};
+            }
+        }
+    };
+#endif
+
+#if defined(__AVX2__)
+    // 8 x 32 bits from an 8 x 32 bits source: one vpermd.
+    template <typename T, std::size_t N0, std::size_t N1, std::size_t N2, std::size_t N3,
+                          std::size_t N4, std::size_t N5, std::size_t N6, std::size_t N7>
+    struct gather<T, 8, N0, N1, N2, N3, N4, N5, N6, N7>
+    {
+        static std::array<T, 8> apply(std::array<T, 8> const& src)
+        {
+            if constexpr (is_lane_32_v<T>)
+            {
+                std::array<T, 8> dst;
+                __m256i const idx = _mm256_setr_epi32(N0, N1, N2, N3, N4, N5, N6, N7);
+                __m256i v = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(src.data()));
+                v = _mm256_permutevar8x32_epi32(v, idx);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst.data()), v);
+                return dst;
+            }
+            else
+            {
+                return {src[N0], src[N1], src[N2], src[N3], src[N4], src[N5], src[N6], src[N7]};
+            }
+        }
+    };
+#endif
+
+    // A scatter of the whole array is a permutation: dst[N_k] = src[k] is dst[j] = src[inv_j], with inv the
+    // inverse permutation, so the scatter is a gather (and gets the same shuffle).
+    template <std::size_t... N>
+    constexpr std::array<std::size_t, sizeof...(N)> inverse()
+    {
+        std::array<std::size_t, sizeof...(N)> inv{};
+        std::size_t k{0};
+        ((inv[N] = k++), ...);
+        return inv;
+    }
+
+    template <typename T, std::size_t size, std::size_t... N, std::size_t... J>
+    std::array<T, size> gather_inverse(std::array<T, size> const& src, integer_seq<N...>, std::index_sequence<J...>)
+    {
+        constexpr auto inv = inverse<N...>();
+        return gather<T, size, inv[J]...>::apply(src);
+    }
+}
+
+
+template <std::size_t... N, typename T, std::size_t size>
+std::array<T, sizeof...(N)> gather(std::array<T, size> const& src, integer_seq<N...> = {})
+{
+    static_assert(detail::all_in_range<size, N...>(), "gather: index out of range");
+    return detail::gather<T, size, N...>::apply(src);
+}
+
+// Every destination slot is written at most once, otherwise the result depends on the order of the writes.
+template <std::size_t... N, typename T, std::size_t src_size, std::size_t dst_size>
+void scatter(std::array<T, src_size> const& src, std::array<T, dst_size>& dst, integer_seq<N...> = {})
+{
+    static_assert(sizeof...(N) == src_size, "scatter: one index per source element");
+    static_assert(detail::all_in_range<dst_size, N...>(), "scatter: index out of range");
+    static_assert(detail::all_unique<N...>(), "scatter: the same slot is written twice");
+
+    if constexpr (src_size == dst_size)
+    {
+        dst = detail::gather_inverse(src, integer_seq<N...>{}, std::make_index_sequence<src_size>{});
+    }
+    else
+    {
+        std::size_t k{0};
+        ((dst[N] = src[k++]), ...);
+    }
+}
+
+template <std::size_t... N, typename T, std::size_t size>
+std::array<T, size> permute(std::array<T, size> const& src, integer_seq<N...> seq = {})
+{
+    static_assert(sizeof...(N) == size, "permute: one index per element");
+    static_assert(detail::all_unique<N...>(), "permute: not a permutation");
+    return gather(src, seq);
+}
+
+
+template <typename A>
+void print(A const& arr)
+{
+    for (auto const& a: arr) { std::cout << a << ' '; }
+    std::cout << '\n';
+}
+
+int main()
+{
+    std::array<int, 4> arr{0,1,2,3};
+
+    // column picking (scalar moves).
+    print(gather(arr, integer_seq<1,3>{}));                     // 1 3
+
+    // a full reversal: a single shuffle when SSE2 is available.
+    print(permute(arr, integer_seq<3,2,1,0>{}));                // 3 2 1 0
+
+    // the indices can be given directly as template arguments.
+    print(gather<0,0,2,2>(arr));                                // 0 0 2 2
+
+    // floats are 32 bit lanes as well.
+    std::array<float, 8> farr{0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f};
+    print(permute<7,6,5,4,0,1,2,3>(farr));                      // 7.5 6.5 5.5 4.5 0.5 1.5 2.5 3.5
+
+    // doubles don't fit the 32 bit shuffles, they take the scalar path.
+    std::array<double, 4> darr{0.25, 1.25, 2.25, 3.25};
+    print(permute<1,0,3,2>(darr));                              // 1.25 0.25 3.25 2.25
+
+    // field reordering back: scatter is the inverse of gather.
+    std::array<int, 4> back{};
+    scatter(gather<2,0,3,1>(arr), back, integer_seq<2,0,3,1>{});
+    print(back);                                                // 0 1 2 3
+
+    // a scatter into an array of the same size is the inverse permutation: one vpermd with AVX2.
+    std::array<float, 8> fback{};
+    scatter<3,7,0,4,1,5,2,6>(farr, fback);
+    print(fback);                                               // 2.5 4.5 6.5 0.5 3.5 5.5 7.5 1.5
+
+    // a partial scatter stays scalar.
+    std::array<int, 4> part{9, 9, 9, 9};
+    scatter<3,1>(std::array<int, 2>{5, 6}, part);
+    print(part);                                                // 9 6 9 5
+
+    // These don't compile:
+    // gather<4>(arr);                       // index out of range
+    // permute<0,0,1,2>(arr);                // not a permutation
+    // scatter<0,0>(std::array<int,2>{}, back);  // the same slot is written twice
+}
@@ -0,0 +1,241 @@
+#include <iostream>
+#include <ranges>
+#include <iterator>
+#include <utility>
+#include <optional>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <cstdlib>
+#include <cstddef>
+#include <new>
+
+// Needs C++20: g++ -std=c++20 join_view.cpp
+//
+// In set_intersection.cpp, main joins A and B into a std::vector<std::string>: an ostringstream and a string
+// per match, and a vector to hold them, even if all we want next is a sum over the matches.
+//
+// my::views::join(A, B, cmp) is the same loop as my::join, turned inside out: the iterator stops at every
+// match and gives the pair of (references to) the matching elements; ++ resumes the loop. Nothing is
+// computed before it is asked for, and nothing is allocated, so a
+//     my::views::join(A, B, cmp{}) | std::views::filter(...) | std::views::transform(...)
+// is one pass over A and B, and the combiner is whatever the caller does with the pair.
+// my::views::set_intersection(A, B, cmp) is the same for my::set_intersection.
+// Finding the first match walks up to it, so begin() does it once and keeps the result (like
+// std::ranges::filter_view): a range must give begin() in amortized constant time.
+
+namespace my
+{
+  enum class match_kind { join, intersection };
+
+  template <std::ranges::forward_range R1, std::ranges::forward_range R2, typename Comparator, match_kind kind>
+    requires std::ranges::view<R1> && std::ranges::view<R2>
+  class join_view : public std::ranges::view_interface<join_view<R1, R2, Comparator, kind>>
+  {
+  public:
+    join_view() = default;
+    join_view(R1 r1_, R2 r2_, Comparator cmp_) : r1{std::move(r1_)}, r2{std::move(r2_)}, cmp{std::move(cmp_)} {}
+
+    class iterator
+    {
+    public:
+      using reference         = std::pair<std::ranges::range_reference_t<R1>, std::ranges::range_reference_t<R2>>;
+      using value_type        = reference;  // a pair of references: the elements stay where they are.
+      using difference_type   = std::ptrdiff_t;
+      using iterator_concept  = std::forward_iterator_tag;
+      using iterator_category = std::input_iterator_tag;  // * returns a prvalue.
+
+      iterator() = default;
+
+      iterator(join_view* parent_)
+        : parent{parent_},
+          first1{std::ranges::begin(parent_->r1)},
+          first2{std::ranges::begin(parent_->r2)},
+          fixed_f2{first2}
+      {
+        satisfy();
+      }
+
+      reference operator*() const { return {*first1, *first2}; }
+
+      iterator& operator++()
+      {
+        // the step my::join takes after a match: comb(*first1, *first2++).
+        if constexpr (kind == match_kind::intersection) { ++first1; }
+        ++first2;
+        satisfy();
+        return *this;
+      }
+
+      iterator operator++(int) { auto tmp = *this; ++*this; return tmp; }
+
+      friend bool operator==(iterator const& x, iterator const& y) { return (x.first1 == y.first1) && (x.first2 == y.first2); }
+
+      friend bool operator==(iterator const& x, std::default_sentinel_t) { return x.done(); }
+
+    private:
+      auto last1() const { return std::ranges::end(parent->r1); }
+      auto last2() const { return std::ranges::end(parent->r2); }
+
+      bool done() const
+      {
+        if constexpr (kind == match_kind::intersection) { return (first1 == last1()) || (first2 == last2()); }
+        else                                            { return (first1 == last1()) || (fixed_f2 == last2()); }
+      }
+
+      // The loop of my::join / my::set_intersection, up to (not through) the next match.
+      void satisfy()
+      {
+        auto& cmp = parent->cmp;
+        if constexpr (kind == match_kind::intersection)
+        {
+          while (!done())
+          {
+               if      (cmp(*first1, *first2)) { ++first1; }
+               else if (cmp(*first2, *first1)) { ++first2; }
+               else                            { return; }
+          }
+        }
+        else
+        {
+          while (!done())
+          {
+               if      ((first2 == last2()) || cmp(*first1, *first2)) { ++first1; first2 = fixed_f2; }
+               else if (cmp(*first2, *first1)) { ++first2; fixed_f2 = first2; }
+               else                            { return; }
+          }
+        }
+      }
+
+      join_view* parent{nullptr};
+      std::ranges::iterator_t<R1> first1{};
+      std::ranges::iterator_t<R2> first2{};
+      std::ranges::iterator_t<R2> fixed_f2{};   // the start of the run of equal keys in r2 (join only).
+    };
+
+    iterator begin()
+    {
+      if (!first_match.it) { first_match.it.emplace(this); }
+      return *first_match.it;
+    }
+    std::default_sentinel_t end() const { return {}; }
+
+  private:
+    // The cached begin() points to its view: a copy of the view starts with an empty cache.
+    struct begin_cache
+    {
+      std::optional<iterator> it;
+
+      begin_cache() = default;
+      begin_cache(begin_cache const&) {}
+      begin_cache& operator=(begin_cache const&) { it.reset(); return *this; }
+    };
+
+    R1 r1;
+    R2 r2;
+    Comparator cmp;   // not const: the comparators of set_intersection.cpp have a non-const operator().
+    begin_cache first_match;
+  };
+
+
+  namespace views
+  {
+    template <std::ranges::viewable_range R1, std::ranges::viewable_range R2, typename Comparator>
+    auto join(R1&& r1, R2&& r2, Comparator cmp)
+    {
+      return join_view<std::views::all_t<R1>, std::views::all_t<R2>, Comparator, match_kind::join>{
+               std::views::all(std::forward<R1>(r1)), std::views::all(std::forward<R2>(r2)), std::move(cmp)};
+    }
+
+    template <std::ranges::viewable_range R1, std::ranges::viewable_range R2, typename Comparator>
+    auto set_intersection(R1&& r1, R2&& r2, Comparator cmp)
+    {
+      return join_view<std::views::all_t<R1>, std::views::all_t<R2>, Comparator, match_kind::intersection>{
+               std::views::all(std::forward<R1>(r1)), std::views::all(std::forward<R2>(r2)), std::move(cmp)};
+    }
+  }
+}
+
+
+// Counts the allocations, to show that the view does none.
+static std::size_t allocations{0};
+
+void* operator new(std::size_t n)
+{
+    ++allocations;
+    if (void* p = std::malloc(n)) { return p; }
+    throw std::bad_alloc{};
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+
+
+
+
+struct S
+{
+   explicit S(int id_, int v_) : id{id_}, v{v_} {}
+   int id;
+   int v;
+};
+
+
+struct M
+{
+   explicit M(int id_, int v_) : id{id_}, v{v_} {}
+   int id;
+   int v;
+};
+
+std::ostream& operator<<(std::ostream& os, S s) { return os << "S{" << s.id << ", " << s.v << "}"; }
+std::ostream& operator<<(std::ostream& os, M m) { return os << "M{" << m.id << ", " << m.v << "}"; }
+
+struct cmp
+{
+    bool operator()(S s, M m) { ++calls; return s.id < m.id; }
+    bool operator()(M m, S s) { ++calls; return m.id < s.id; }
+
+    static inline std::size_t calls{0};
+};
+
+
+int main()
+{
+    std::vector<M> const A{M{2,2},M{2,3}, M{5,5}, M{7,1}};
+    std::vector<S> const B{S{2,1},S{2,4}, S{7,6}};
+
+    static_assert(std::ranges::forward_range<decltype(my::views::join(A, B, cmp{}))>);
+
+    // The pairs of the example of set_intersection.cpp, without building any string.
+    for (auto [m, s]: my::views::join(A, B, cmp{})) { std::cout << m << "-" << s << ' '; }
+    std::cout << '\n';
+    // This prints: M{2, 2}-S{2, 1} M{2, 2}-S{2, 4} M{2, 3}-S{2, 1} M{2, 3}-S{2, 4} M{7, 1}-S{7, 6}
+
+    for (auto [m, s]: my::views::set_intersection(A, B, cmp{})) { std::cout << m << "-" << s << ' '; }
+    std::cout << '\n';
+    // This prints: M{2, 2}-S{2, 1} M{2, 3}-S{2, 4} M{7, 1}-S{7, 6}
+
+    // An aggregation as one fused pass: the join, a filter and a transform, and nothing materialized.
+    std::size_t const before = allocations;
+    auto products = my::views::join(A, B, cmp{})
+                  | std::views::filter([](auto const& p) { return p.first.v > 2; })
+                  | std::views::transform([](auto const& p) { return p.first.v * p.second.v; });
+    int sum{0};
+    for (int x: products) { sum += x; }
+    std::cout << "sum: " << sum << ", allocations: " << (allocations - before) << '\n';  // sum: 15, allocations: 0
+
+    // The references are to the elements of A and B.
+    auto first = *my::views::join(A, B, cmp{}).begin();
+    std::cout << "same element: " << (&first.first == &A[0]) << '\n';  // 1
+
+    // begin() finds the first match once: take / drop / distance call it again for free.
+    std::vector<M> const late{M{1,0}, M{3,0}, M{4,0}, M{6,0}, M{7,2}};
+    auto view = my::views::join(late, B, cmp{});
+    view.begin();
+    std::size_t const calls = cmp::calls;
+    auto [m, s] = *view.begin();
+    std::cout << "first match " << m << "-" << s << ", comparisons in the second begin(): " << (cmp::calls - calls)
+              << ", matches: " << std::ranges::distance(view) << '\n';   // first match M{7, 2}-S{7, 6}, ...: 0, matches: 1
+}
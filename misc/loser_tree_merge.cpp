@@ -0,0 +1,347 @@
+#include <iostream>
+#include <algorithm>
+#include <vector>
+#include <queue>
+#include <tuple>
+#include <functional>
+#include <utility>
+#include <type_traits>
+#include <cstdint>
+#include <cstddef>
+#include <chrono>
+#include <random>
+
+// "std::merge is not just for sorting" (_posts/2020-3-5-merge_is_not_just_for_sort.md) feeds a simulator from
+// two sorted sources, mkt_src and sig_src, with std::merge, a timestamp comparator and a function output
+// iterator. With hundreds of sources (one per instrument), merging them two by two re-merges every message
+// log K times, and a std::priority_queue moves whole entries around its heap.
+//
+// A loser tree (tournament tree) has one leaf per source and remembers, in every internal node, the loser of
+// the match played there. The overall winner is the next message. When it is consumed, only its leaf changes,
+// so only its path to the root is replayed: log K comparisons, each against the loser stored on the way.
+//
+//   - the sources can hold different message types (M, S, ...): a leaf only keeps the timestamp of its current
+//     message, the tree compares timestamps, and a per leaf function pointer hands the message to the sink with
+//     its real type (sim(m) or sim(s), like the function output iterator of the post),
+//   - a source gives its messages in batches (next_batch()); when a leaf moves to a new batch, or walks
+//     through one, the next cache lines are prefetched,
+//   - ties go to the source added first, then to the earlier message in that source: the order of std::merge,
+//     which takes from its first range on ties.
+
+namespace my
+{
+  // A source over a sorted range in memory, given out in batches of `batch` messages.
+  // Any type with value_type and std::pair<value_type const*, value_type const*> next_batch() is a source too
+  // (a file reader, a decoder, ...); an empty batch means the source is exhausted.
+  template <typename T>
+  class span_source
+  {
+  public:
+    using value_type = T;
+
+    span_source(T const* first_, T const* last_, std::size_t batch_ = 256) : first{first_}, last{last_}, batch{batch_} {}
+
+    template <typename Container>
+    explicit span_source(Container const& c, std::size_t batch_ = 256) : span_source{c.data(), c.data() + c.size(), batch_} {}
+
+    std::pair<T const*, T const*> next_batch()
+    {
+      T const* const b = first;
+      first = std::min(last, first + batch);
+      return {b, first};
+    }
+
+  private:
+    T const* first;
+    T const* last;
+    std::size_t batch;
+  };
+
+  template <typename Container>
+  span_source(Container const&, std::size_t = 256) -> span_source<typename Container::value_type>;
+
+
+  // Key: the type of the timestamps; KeyFn: key(message) for every message type; Sink: sink(message).
+  template <typename Key, typename KeyFn, typename Sink>
+  class loser_tree_merge
+  {
+  public:
+    loser_tree_merge(KeyFn key_, Sink& sink_) : key{key_}, sink{sink_} {}
+
+    // The source must outlive the merge. The order of add() decides the ties.
+    template <typename Source>
+    void add(Source& source)
+    {
+      leaf l;
+      l.source = &source;
+      l.stride = sizeof(typename Source::value_type);
+      l.refill = &refill_thunk<Source>;
+      l.emit = &emit_thunk<typename Source::value_type>;
+      l.key_of = &key_thunk<typename Source::value_type>;
+      leaves.push_back(l);
+    }
+
+    // Merges everything into the sink. Returns the number of messages.
+    std::size_t run()
+    {
+      if (leaves.empty()) { return 0; }
+      for (auto& l: leaves) { refill(l); }
+      build();
+
+      // The winner is exhausted when every leaf is, the padding leaves included (they are never in `leaves`).
+      std::size_t count{0};
+      for (std::size_t w = tree[0]; !exhausted[w]; w = tree[0])
+      {
+        leaf& l = leaves[w];
+        l.emit(l.cur, sink);
+        ++count;
+        advance(l);
+        sync(w);
+        replay(w);
+      }
+      return count;
+    }
+
+  private:
+    struct leaf
+    {
+      Key k{};
+      char const* cur{nullptr};
+      char const* end{nullptr};
+      std::size_t stride{0};
+      bool done{true};
+      void* source{nullptr};
+      std::pair<char const*, char const*> (*refill)(void*){nullptr};
+      void (*emit)(char const*, Sink&){nullptr};
+      Key (*key_of)(char const*, KeyFn&){nullptr};
+    };
+
+    template <typename Source>
+    static std::pair<char const*, char const*> refill_thunk(void* source)
+    {
+      auto [b, e] = static_cast<Source*>(source)->next_batch();
+      return {reinterpret_cast<char const*>(b), reinterpret_cast<char const*>(e)};
+    }
+
+    template <typename T>
+    static void emit_thunk(char const* p, Sink& sink) { sink(*reinterpret_cast<T const*>(p)); }
+
+    template <typename T>
+    static Key key_thunk(char const* p, KeyFn& key) { return key(*reinterpret_cast<T const*>(p)); }
+
+    // Messages ahead of the current one to prefetch, as the leaf walks its batch.
+    static constexpr std::size_t prefetch_distance = 8;
+
+    void refill(leaf& l)
+    {
+      auto [b, e] = l.refill(l.source);
+      l.cur = b;
+      l.end = e;
+      l.done = (b == e);
+      if (!l.done)
+      {
+        __builtin_prefetch(b);
+        __builtin_prefetch(std::min(e - 1, b + prefetch_distance * l.stride));
+        l.k = l.key_of(b, key);
+      }
+    }
+
+    void advance(leaf& l)
+    {
+      l.cur += l.stride;
+      if (l.cur == l.end) { refill(l); return; }
+      if (l.cur + prefetch_distance * l.stride < l.end) { __builtin_prefetch(l.cur + prefetch_distance * l.stride); }
+      l.k = l.key_of(l.cur, key);
+    }
+
+    // a comes before b: the smaller key, then the source added first. An exhausted leaf loses to all.
+    // The tree only reads the compact copies in keys/exhausted (one cache line holds many leaves).
+    bool before(std::size_t a, std::size_t b) const
+    {
+      if (exhausted[a] != exhausted[b]) { return exhausted[b]; }
+      if (keys[a] < keys[b]) { return true; }
+      if (keys[b] < keys[a]) { return false; }
+      return a < b;
+    }
+
+    void sync(std::size_t i)
+    {
+      exhausted[i] = leaves[i].done;
+      if (!leaves[i].done) { keys[i] = leaves[i].k; }
+    }
+
+    // P leaves (a power of 2, the extra ones are exhausted); tree[n] is the loser at node n, tree[0] the winner.
+    void build()
+    {
+      P = 1;
+      while (P < leaves.size()) { P *= 2; }
+      tree.assign(P, 0);
+      keys.assign(P, Key{});
+      exhausted.assign(P, 1);
+      for (std::size_t i{0}; i < leaves.size(); ++i) { sync(i); }
+      std::vector<std::size_t> winner(2 * P);
+      for (std::size_t i{0}; i < P; ++i) { winner[P + i] = i; }
+      for (std::size_t n{P - 1}; n >= 1; --n)
+      {
+        std::size_t const a = winner[2 * n], b = winner[2 * n + 1];
+        bool const a_wins = !before(b, a);
+        winner[n] = a_wins ? a : b;
+        tree[n] = a_wins ? b : a;
+      }
+      tree[0] = winner[1];
+    }
+
+    // Leaf w changed: replay its path. At every node, the stored loser plays the climbing winner.
+    void replay(std::size_t w)
+    {
+      for (std::size_t n{(w + P) / 2}; n >= 1; n /= 2)
+      {
+        if (before(tree[n], w)) { std::swap(tree[n], w); }
+      }
+      tree[0] = w;
+    }
+
+    KeyFn key;
+    Sink& sink;
+    std::vector<leaf> leaves;
+    std::vector<std::size_t> tree;
+    std::vector<Key> keys;
+    std::vector<unsigned char> exhausted;
+    std::size_t P{1};
+  };
+}
+
+
+// The two message types of the post, with a timestamp.
+struct M
+{
+  std::int64_t ts;
+  int price;
+};
+
+struct S
+{
+  std::int64_t ts;
+  int signal;
+};
+
+struct ts_of
+{
+  std::int64_t operator()(M const& m) const { return m.ts; }
+  std::int64_t operator()(S const& s) const { return s.ts; }
+};
+
+// Keeps the order it saw, to compare the merges.
+struct Simulator
+{
+  void operator()(M const& m) { seen.push_back({m.ts, m.price}); }
+  void operator()(S const& s) { seen.push_back({s.ts, -s.signal}); }
+
+  std::vector<std::pair<std::int64_t, int>> seen;
+};
+
+
+int main()
+{
+    // The example of the post: one market data source and one signal source.
+    {
+        std::vector<M> mkt_src{{1, 10}, {3, 11}, {3, 12}, {7, 13}};
+        std::vector<S> sig_src{{2, 1}, {3, 2}, {8, 3}};
+        my::span_source mkt{mkt_src};
+        my::span_source sig{sig_src};
+
+        Simulator sim;
+        my::loser_tree_merge<std::int64_t, ts_of, Simulator> merge{ts_of{}, sim};
+        merge.add(mkt);
+        merge.add(sig);
+        merge.run();
+        for (auto [ts, v]: sim.seen) { std::cout << ts << ':' << v << ' '; }
+        std::cout << '\n';
+        // This prints: 1:10 2:-1 3:11 3:12 3:-2 7:13 8:-3   (on ties, mkt_src first, like std::merge)
+    }
+
+    // 3 sources: not a power of 2, the tree has one padding leaf.
+    {
+        std::vector<M> mkt_a{{1, 10}, {4, 11}};
+        std::vector<M> mkt_b{{2, 20}, {4, 21}, {9, 22}};
+        std::vector<S> sig_src{{3, 1}};
+        my::span_source a{mkt_a};
+        my::span_source b{mkt_b};
+        my::span_source sig{sig_src};
+
+        Simulator sim;
+        my::loser_tree_merge<std::int64_t, ts_of, Simulator> merge{ts_of{}, sim};
+        merge.add(a);
+        merge.add(b);
+        merge.add(sig);
+        auto const count = merge.run();
+        std::cout << count << " messages: ";
+        for (auto [ts, v]: sim.seen) { std::cout << ts << ':' << v << ' '; }
+        std::cout << '\n';
+        // This prints: 6 messages: 1:10 2:20 3:-1 4:11 4:21 9:22
+    }
+
+    // 300 instruments: 200 market data sources and 100 signal sources, with plenty of equal timestamps.
+    std::mt19937 gen{29};
+    std::uniform_int_distribution<std::int64_t> step{0, 3};
+    auto make = [&](auto tag, std::size_t n, int id)
+    {
+        using T = typename decltype(tag)::type;
+        std::vector<T> v;
+        std::int64_t ts{0};
+        for (std::size_t i{0}; i < n; ++i) { ts += step(gen); v.push_back(T{ts, id * 100'000 + static_cast<int>(i)}); }
+        return v;
+    };
+    struct m_tag { using type = M; };
+    struct s_tag { using type = S; };
+
+    std::vector<std::vector<M>> mkt;
+    std::vector<std::vector<S>> sig;
+    for (int i{0}; i < 200; ++i) { mkt.push_back(make(m_tag{}, 20'000, i)); }
+    for (int i{0}; i < 100; ++i) { sig.push_back(make(s_tag{}, 20'000, 200 + i)); }
+
+    auto time = [](auto f)
+    {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    // the loser tree.
+    Simulator tree_sim;
+    tree_sim.seen.reserve(6'000'000);
+    auto t_tree = time([&]()
+    {
+        std::vector<my::span_source<M>> ms;
+        std::vector<my::span_source<S>> ss;
+        for (auto const& v: mkt) { ms.emplace_back(v); }
+        for (auto const& v: sig) { ss.emplace_back(v); }
+        my::loser_tree_merge<std::int64_t, ts_of, Simulator> merge{ts_of{}, tree_sim};
+        for (auto& s: ms) { merge.add(s); }
+        for (auto& s: ss) { merge.add(s); }
+        merge.run();
+    });
+
+    // the usual alternative: a std::priority_queue of (timestamp, source, position).
+    Simulator heap_sim;
+    heap_sim.seen.reserve(6'000'000);
+    auto t_heap = time([&]()
+    {
+        using entry = std::tuple<std::int64_t, std::size_t, std::size_t>;
+        std::priority_queue<entry, std::vector<entry>, std::greater<entry>> heap;
+        auto ts_at = [&](std::size_t s, std::size_t i) { return s < mkt.size() ? mkt[s][i].ts : sig[s - mkt.size()][i].ts; };
+        auto size_of = [&](std::size_t s) { return s < mkt.size() ? mkt[s].size() : sig[s - mkt.size()].size(); };
+        for (std::size_t s{0}; s < mkt.size() + sig.size(); ++s) { if (size_of(s) > 0) { heap.push({ts_at(s, 0), s, 0}); } }
+        while (!heap.empty())
+        {
+            auto [ts, s, i] = heap.top();
+            heap.pop();
+            if (s < mkt.size()) { heap_sim(mkt[s][i]); } else { heap_sim(sig[s - mkt.size()][i]); }
+            if (i + 1 < size_of(s)) { heap.push({ts_at(s, i + 1), s, i + 1}); }
+        }
+    });
+
+    std::cout << "loser tree:     " << tree_sim.seen.size() << " messages in " << t_tree << "us\n";
+    std::cout << "priority_queue: " << heap_sim.seen.size() << " messages in " << t_heap << "us"
+              << (heap_sim.seen == tree_sim.seen ? ", same order" : ", DIFFERENT order") << '\n';
+}
@@ -0,0 +1,197 @@
+#include <iostream>
+#include <type_traits>
+#include <utility>
+#include <tuple>
+#include <array>
+
+// raw_sub_list and create_tuple give us std::tuples in declaration order.
+// For types_list<char, double, short, int, char> that's a lot of padding:
+// char(1) + pad(7) + double(8) + short(2) + pad(2) + int(4) + char(1) + pad(7) = 32 bytes for 16 bytes of data.
+//
+// If we sort the fields by alignment (and then size), all the padding ends up at the tail: 16 bytes.
+// The catch: the field indices change. So we keep a remapping, and callers keep using the
+// original indices (get<1>() is still the double).
+
+template <typename... Args>
+struct types_list {};
+
+
+namespace detail
+{
+    template <std::size_t n, typename... Args>
+    struct get_type;
+
+    template <typename T, typename... Others>
+    struct get_type<0, T, Others...>
+    {
+        using type = T;
+    };
+
+    template <std::size_t n, typename T, typename... Others>
+    struct get_type<n, T, Others...>
+    {
+        using type = typename get_type<n-1, Others...>::type;
+    };
+}
+
+
+namespace detail
+{
+
+  constexpr std::size_t get_number(std::size_t n) { return n; }
+
+  template <typename T>
+  constexpr std::size_t get_number(T n) { return static_cast<std::size_t>(n); }
+}
+
+
+template <auto n, typename... Args>
+struct get_type_base
+{
+   static constexpr std::size_t sn = detail::get_number(n);
+   using type = typename detail::get_type<sn, Args...>::type;
+};
+
+template <auto  n, typename... Args>
+struct get_type : get_type_base<n, Args...>
+{
+};
+
+template <auto n, template <typename...> typename TypeContainer, typename... Args>
+struct get_type<n, TypeContainer<Args...>> : get_type_base<n, Args...> {};
+
+template <auto n, typename... Args>
+using get_type_t = typename get_type<n, Args...>::type;
+
+
+namespace detail
+{
+    // packed_order[k] is the original index of the k-th field in the packed layout.
+    // A constexpr insertion sort: the lists are small, and it is stable, so equal fields keep
+    // their declaration order.
+    template <typename... Ts>
+    constexpr std::array<std::size_t, sizeof...(Ts)> packed_order()
+    {
+        constexpr std::size_t n = sizeof...(Ts);
+        std::array<std::size_t, n> order{};
+        std::array<std::size_t, n> const align{alignof(Ts)...};
+        std::array<std::size_t, n> const size{sizeof(Ts)...};
+
+        auto goes_before = [&](std::size_t a, std::size_t b)
+        {
+            if (align[a] != align[b]) { return align[a] > align[b]; }
+            return size[a] > size[b];
+        };
+
+        for (std::size_t i{0}; i < n; ++i)
+        {
+            std::size_t j{i};
+            for ( ; (j > 0) && goes_before(i, order[j-1]); --j) { order[j] = order[j-1]; }
+            order[j] = i;
+        }
+        return order;
+    }
+
+    // The inverse: slot[i] is where the original field i lives in the packed tuple.
+    template <typename... Ts>
+    constexpr std::array<std::size_t, sizeof...(Ts)> packed_slots()
+    {
+        constexpr auto order = packed_order<Ts...>();
+        std::array<std::size_t, sizeof...(Ts)> slot{};
+        for (std::size_t k{0}; k < order.size(); ++k) { slot[order[k]] = k; }
+        return slot;
+    }
+
+    template <typename TypeList, typename Indices>
+    struct packed_tuple;
+
+    template <typename... Ts, std::size_t... Ks>
+    struct packed_tuple<types_list<Ts...>, std::index_sequence<Ks...>>
+    {
+        static constexpr auto order = packed_order<Ts...>();
+        using type = std::tuple<get_type_t<order[Ks], Ts...>...>;
+    };
+}
+
+
+template <typename TypeList>
+struct packed_layout;
+
+template <typename... Ts>
+struct packed_layout<types_list<Ts...>>
+{
+    using field_list = types_list<Ts...>;
+
+    static constexpr std::array<std::size_t, sizeof...(Ts)> order = detail::packed_order<Ts...>();
+    static constexpr std::array<std::size_t, sizeof...(Ts)> slot  = detail::packed_slots<Ts...>();
+
+    // Note: libstdc++ lays out std::tuple back to front. That's fine, ascending alignment packs
+    // exactly as well as descending alignment (every pad rounds up to a divisor of the next alignment).
+    using type = typename detail::packed_tuple<field_list, std::index_sequence_for<Ts...>>::type;
+};
+
+template <typename TypeList>
+using packed_tuple_t = typename packed_layout<TypeList>::type;
+
+
+// A record stored in the packed layout but addressed with the original field indices.
+template <typename TypeList>
+class packed_record;
+
+template <typename... Ts>
+class packed_record<types_list<Ts...>>
+{
+public:
+    using layout = packed_layout<types_list<Ts...>>;
+
+    packed_record() = default;
+
+    // arguments in declaration order, like create_tuple.
+    packed_record(Ts... ts) : packed_record(std::tuple<Ts...>{std::move(ts)...}, std::index_sequence_for<Ts...>{}) {}
+
+    template <std::size_t I>
+    get_type_t<I, Ts...>& get() { return std::get<layout::slot[I]>(data); }
+
+    template <std::size_t I>
+    get_type_t<I, Ts...> const& get() const { return std::get<layout::slot[I]>(data); }
+
+private:
+    template <std::size_t... Ks>
+    packed_record(std::tuple<Ts...>&& t, std::index_sequence<Ks...>)
+        : data{std::move(std::get<layout::order[Ks]>(t))...}
+    {}
+
+    typename layout::type data;
+};
+
+// get_type works on a packed_record with the original indices, like on the plain list.
+template <auto n, typename... Ts>
+struct get_type<n, packed_record<types_list<Ts...>>> : get_type_base<n, Ts...> {};
+
+template <std::size_t I, typename TypeList>
+decltype(auto) get(packed_record<TypeList>& r) { return r.template get<I>(); }
+
+template <std::size_t I, typename TypeList>
+decltype(auto) get(packed_record<TypeList> const& r) { return r.template get<I>(); }
+
+
+int main()
+{
+    using fields = types_list<char, double, short, int, char>;
+
+    constexpr auto order = packed_layout<fields>::order;
+    static_assert(order[0] == 1 && order[1] == 3 && order[2] == 2 && order[3] == 0 && order[4] == 4);
+    static_assert(std::is_same_v<packed_tuple_t<fields>, std::tuple<double, int, short, char, char>>);
+
+    static_assert(sizeof(std::tuple<char, double, short, int, char>) == 32);
+    static_assert(sizeof(packed_tuple_t<fields>) == 16);
+    static_assert(sizeof(packed_record<fields>) == 16);
+
+    static_assert(std::is_same_v<get_type_t<1, packed_record<fields>>, double>);
+
+    packed_record<fields> r{'a', 2.5, 3, 4, 'e'};
+    std::cout << get<0>(r) << ' ' << get<1>(r) << ' ' << get<2>(r) << ' ' << get<3>(r) << ' ' << get<4>(r) << '\n'; // a 2.5 3 4 e
+
+    get<1>(r) = 7.25;
+    std::cout << r.get<1>() << '\n'; // 7.25
+}
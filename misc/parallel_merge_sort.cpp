@@ -0,0 +1,422 @@
+#include <iostream>
+#include <algorithm>
+#include <iterator>
+#include <utility>
+#include <type_traits>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <atomic>
+#include <cstdint>
+#include <chrono>
+#include <random>
+
+// The merge_sort of the merge post (_posts/2020-3-5-merge_is_not_just_for_sort.md) returns a new Container at
+// every level of the recursion and merges through a back_inserter: O(n) allocations and O(n log n) copies.
+//
+// my::merge_sort allocates once: a scratch buffer as big as the input. A level of the recursion merges from
+// one of the two arrays into the other, and the next level up goes the other way (ping-pong), so the elements
+// are moved once per level and never copied around. Below `small` elements, insertion sort (in the input),
+// which beats the recursion on a few cache lines.
+//
+// In parallel:
+//   - the two halves of a range are sorted as two tasks of a work stealing pool (the one of
+//     parallel_pipeline_executor.cpp); a task never waits for another: the last of the two halves to finish
+//     runs the merge (a counter per merge, like the dependency counters of the pipeline executor),
+//   - a big merge is cut with merge path into chunks of the same size (a binary search on a diagonal gives
+//     where each chunk starts in both halves), and the chunks are merged in parallel.
+// The merges take the left element on ties, and insertion sort doesn't jump over equal elements: it is stable.
+
+
+// ------------------------------------------------------------------------------------------------
+// A small work stealing pool.
+// Every worker owns a deque: it pushes and pops at the back (the most recent, still hot in cache),
+// and idle workers steal from the front of the others (the oldest, usually the biggest piece of work).
+// ------------------------------------------------------------------------------------------------
+
+class work_stealing_pool
+{
+public:
+    using task_t = std::function<void()>;
+
+    explicit work_stealing_pool(std::size_t n = std::thread::hardware_concurrency())
+        : queues(n == 0 ? 1 : n)
+    {
+        for (std::size_t i{0}; i < queues.size(); ++i)
+        {
+            workers.emplace_back([this, i]() { work(i); });
+        }
+    }
+
+    ~work_stealing_pool()
+    {
+        {
+            std::lock_guard<std::mutex> lock{sleep_mutex};
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& w: workers) { w.join(); }
+    }
+
+    work_stealing_pool(work_stealing_pool const&) = delete;
+    work_stealing_pool& operator=(work_stealing_pool const&) = delete;
+
+    // From a worker, the task goes to its own deque; from the outside, round robin.
+    void submit(task_t task)
+    {
+        std::size_t const q = (current_pool() == this) ? current_worker()
+                                                        : next_queue++ % queues.size();
+        {
+            std::lock_guard<std::mutex> lock{queues[q].mutex};
+            queues[q].tasks.push_back(std::move(task));
+        }
+        {
+            std::lock_guard<std::mutex> lock{sleep_mutex};
+            ++pending;
+        }
+        wake.notify_one();
+    }
+
+    std::size_t size() const { return queues.size(); }
+
+    // The index of the calling worker in its pool, or no_worker outside of any pool.
+    static constexpr std::size_t no_worker = std::size_t(-1);
+    static std::size_t this_worker() { return current_pool() ? current_worker() : no_worker; }
+
+private:
+    struct queue
+    {
+        std::mutex mutex;
+        std::deque<task_t> tasks;
+    };
+
+    // which pool (and which deque) the calling thread works for, if any.
+    static work_stealing_pool const*& current_pool()
+    {
+        thread_local work_stealing_pool const* pool{nullptr};
+        return pool;
+    }
+
+    static std::size_t& current_worker()
+    {
+        thread_local std::size_t index{0};
+        return index;
+    }
+
+    bool pop_local(std::size_t i, task_t& task)
+    {
+        std::lock_guard<std::mutex> lock{queues[i].mutex};
+        if (queues[i].tasks.empty()) { return false; }
+        task = std::move(queues[i].tasks.back());
+        queues[i].tasks.pop_back();
+        return true;
+    }
+
+    bool steal(std::size_t i, task_t& task)
+    {
+        for (std::size_t k{1}; k < queues.size(); ++k)
+        {
+            auto& victim = queues[(i + k) % queues.size()];
+            std::lock_guard<std::mutex> lock{victim.mutex};
+            if (!victim.tasks.empty())
+            {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void work(std::size_t i)
+    {
+        current_pool() = this;
+        current_worker() = i;
+        for (;;)
+        {
+            {
+                // pending counts tasks sitting in some deque: no busy spinning when there is nothing.
+                std::unique_lock<std::mutex> lock{sleep_mutex};
+                wake.wait(lock, [this]() { return stopping || pending > 0; });
+                if (pending == 0) { return; } // stopping, and nothing left.
+                --pending;
+            }
+
+            // We reserved one task; it is in some deque, so keep looking until we get it.
+            task_t task;
+            while (!pop_local(i, task) && !steal(i, task)) { std::this_thread::yield(); }
+            task();
+        }
+    }
+
+    std::vector<queue> queues;
+    std::vector<std::thread> workers;
+    std::atomic<std::size_t> next_queue{0};
+
+    std::mutex sleep_mutex;
+    std::condition_variable wake;
+    std::size_t pending{0};
+    bool stopping{false};
+};
+
+
+// ------------------------------------------------------------------------------------------------
+// The sort.
+// ------------------------------------------------------------------------------------------------
+
+namespace my
+{
+  namespace detail
+  {
+    // Stable: an element only moves left past strictly greater ones.
+    template <typename Iterator, typename Less>
+    void insertion_sort(Iterator first, Iterator last, Less& less)
+    {
+      if (first == last) { return; }
+      for (auto i = std::next(first); i != last; ++i)
+      {
+        auto v = std::move(*i);
+        auto j = i;
+        for ( ; (j != first) && less(v, *std::prev(j)); --j) { *j = std::move(*std::prev(j)); }
+        *j = std::move(v);
+      }
+    }
+
+    // Merges [l, l_end) and [r, r_end) into out, left first on ties.
+    template <typename In, typename Out, typename Less>
+    void merge_move(In l, In l_end, In r, In r_end, Out out, Less& less)
+    {
+      for ( ; (l != l_end) && (r != r_end); ++out)
+      {
+        if (less(*r, *l)) { *out = std::move(*r++); }
+        else              { *out = std::move(*l++); }
+      }
+      out = std::move(l, l_end, out);
+      std::move(r, r_end, out);
+    }
+
+    // Merge path: how many elements of the left run are in the first d elements of the (stable) merge.
+    template <typename In, typename Less>
+    std::size_t co_rank(std::size_t d, In l, std::size_t nl, In r, std::size_t nr, Less& less)
+    {
+      std::size_t lo = (d > nr) ? d - nr : 0;
+      std::size_t hi = std::min(d, nl);
+      while (lo < hi)
+      {
+        std::size_t const i = lo + (hi - lo) / 2;
+        if (!less(r[d - i - 1], l[i])) { lo = i + 1; }  // l[i] comes before r[d - i - 1]: i is too small.
+        else                           { hi = i; }
+      }
+      return lo;
+    }
+
+    template <typename Iterator, typename Less>
+    class merge_sorter
+    {
+    public:
+      using value_type = typename std::iterator_traits<Iterator>::value_type;
+      using buffer_iterator = typename std::vector<value_type>::iterator;
+
+      static constexpr std::size_t small = 32;            // insertion sort below
+      static constexpr std::size_t serial = 1 << 15;      // one task below
+      static constexpr std::size_t merge_chunk = 1 << 16; // elements per parallel merge chunk
+
+      merge_sorter(Iterator first_, std::vector<value_type>& buffer_, Less less_, work_stealing_pool* pool_)
+        : first{first_}, buffer{buffer_.begin()}, less{less_}, pool{pool_} {}
+
+      // Sorts [lo, hi) of the input. The result goes to the buffer if to_buffer, else stays in the input.
+      void sort_serial(std::size_t lo, std::size_t hi, bool to_buffer)
+      {
+        if (hi - lo <= small)
+        {
+          insertion_sort(first + lo, first + hi, less);
+          if (to_buffer) { std::move(first + lo, first + hi, buffer + lo); }
+          return;
+        }
+        std::size_t const mid = lo + (hi - lo) / 2;
+        sort_serial(lo, mid, !to_buffer);
+        sort_serial(mid, hi, !to_buffer);
+        merge_range(lo, mid, hi, 0, hi - lo, to_buffer);
+      }
+
+      // The same, as tasks; done() runs when [lo, hi) is sorted.
+      void sort_parallel(std::size_t lo, std::size_t hi, bool to_buffer, std::function<void()> done)
+      {
+        if ((pool == nullptr) || (hi - lo <= serial))
+        {
+          sort_serial(lo, hi, to_buffer);
+          done();
+          return;
+        }
+        std::size_t const mid = lo + (hi - lo) / 2;
+        auto halves = std::make_shared<std::atomic<int>>(2);
+        auto then = [this, halves, lo, mid, hi, to_buffer, done]()
+        {
+          if (--*halves == 0) { merge_parallel(lo, mid, hi, to_buffer, done); }
+        };
+        pool->submit([this, lo, mid, to_buffer, then]() { sort_parallel(lo, mid, !to_buffer, then); });
+        sort_parallel(mid, hi, !to_buffer, then);
+      }
+
+    private:
+      // The part [d0, d1) of the merge of [lo, mid) and [mid, hi), from the other array into the target.
+      void merge_range(std::size_t lo, std::size_t mid, std::size_t hi, std::size_t d0, std::size_t d1, bool to_buffer)
+      {
+        if (to_buffer) { merge_part(first, buffer, lo, mid, hi, d0, d1); }
+        else           { merge_part(buffer, first, lo, mid, hi, d0, d1); }
+      }
+
+      template <typename In, typename Out>
+      void merge_part(In in, Out out, std::size_t lo, std::size_t mid, std::size_t hi, std::size_t d0, std::size_t d1)
+      {
+        std::size_t const nl = mid - lo, nr = hi - mid;
+        In const l = in + lo, r = in + mid;
+        std::size_t const i0 = (d0 == 0) ? 0 : co_rank(d0, l, nl, r, nr, less);
+        std::size_t const i1 = (d1 == nl + nr) ? nl : co_rank(d1, l, nl, r, nr, less);
+        merge_move(l + i0, l + i1, r + (d0 - i0), r + (d1 - i1), out + lo + d0, less);
+      }
+
+      void merge_parallel(std::size_t lo, std::size_t mid, std::size_t hi, bool to_buffer, std::function<void()> done)
+      {
+        std::size_t const n = hi - lo;
+        std::size_t const chunks = std::min(pool->size(), std::max<std::size_t>(1, n / merge_chunk));
+        if (chunks == 1)
+        {
+          merge_range(lo, mid, hi, 0, n, to_buffer);
+          done();
+          return;
+        }
+        auto left = std::make_shared<std::atomic<std::size_t>>(chunks);
+        auto chunk = [this, lo, mid, hi, n, chunks, to_buffer, left, done](std::size_t k)
+        {
+          merge_range(lo, mid, hi, n * k / chunks, n * (k + 1) / chunks, to_buffer);
+          if (--*left == 0) { done(); }
+        };
+        for (std::size_t k{1}; k < chunks; ++k) { pool->submit([chunk, k]() { chunk(k); }); }
+        chunk(0);
+      }
+
+      Iterator first;
+      buffer_iterator buffer;
+      Less less;
+      work_stealing_pool* pool;
+    };
+  }
+
+
+  // Stable sort of [first, last). One allocation: the scratch buffer (value_type must be copy constructible).
+  // With a pool, the work is spread over its workers; the caller waits (it must not be one of them).
+  template <typename Iterator, typename Less = std::less<>>
+  void merge_sort(Iterator first, Iterator last, Less less = {}, work_stealing_pool* pool = nullptr)
+  {
+    using value_type = typename std::iterator_traits<Iterator>::value_type;
+    auto const n = static_cast<std::size_t>(std::distance(first, last));
+    if (n < 2) { return; }
+
+    std::vector<value_type> buffer(first, last);
+    detail::merge_sorter<Iterator, Less> sorter{first, buffer, less, pool};
+    if (pool == nullptr)
+    {
+      sorter.sort_serial(0, n, false);
+      return;
+    }
+
+    std::promise<void> finished;
+    pool->submit([&]() { sorter.sort_parallel(0, n, false, [&]() { finished.set_value(); }); });
+    finished.get_future().wait();
+  }
+}
+
+
+// The copying merge_sort of the post, for the comparison.
+template <typename Container, typename Iter>
+Container merge_sort(Iter first, Iter last)
+{
+    if (std::distance(first, last) <= 1)
+    {
+        return Container{first, last};
+    }
+
+    auto midpoint = std::next(first, std::distance(first, last) / 2);
+    auto c1 = merge_sort<Container>(first, midpoint);
+    auto c2 = merge_sort<Container>(midpoint, last);
+
+    Container c;
+    std::merge(std::cbegin(c1),
+               std::cend(c1),
+               std::cbegin(c2),
+               std::cend(c2),
+               std::back_inserter(c));
+    return c;
+}
+
+
+// An event of a log: sorted on the timestamp, seq tells whether equal timestamps kept their order.
+struct event
+{
+    std::uint32_t ts;
+    std::uint32_t seq;
+};
+
+bool operator<(event const& x, event const& y) { return x.ts < y.ts; }
+
+
+int main()
+{
+    std::mt19937 gen{31};
+    auto make = [&](std::size_t n)
+    {
+        std::uniform_int_distribution<std::uint32_t> pick{0, static_cast<std::uint32_t>(n / 4)};  // ~4 events per timestamp
+        std::vector<event> v(n);
+        for (std::size_t i{0}; i < n; ++i) { v[i] = event{pick(gen), static_cast<std::uint32_t>(i)}; }
+        return v;
+    };
+
+    auto stable_sorted = [](std::vector<event> const& v)
+    {
+        for (std::size_t i{1}; i < v.size(); ++i)
+        {
+            if ((v[i].ts < v[i - 1].ts) || ((v[i].ts == v[i - 1].ts) && (v[i].seq < v[i - 1].seq))) { return false; }
+        }
+        return true;
+    };
+
+    auto time = [](auto f)
+    {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    // the post's version, on a smaller input (it's the slow one).
+    {
+        auto v = make(1'000'000);
+        std::vector<event> out;
+        auto t = time([&]() { out = merge_sort<std::vector<event>>(v.cbegin(), v.cend()); });
+        std::cout << "copying merge_sort, 1M:      " << t << "ms, stable: " << stable_sorted(out) << '\n';
+        auto t2 = time([&]() { my::merge_sort(v.begin(), v.end()); });
+        std::cout << "my::merge_sort, 1M:          " << t2 << "ms, stable: " << stable_sorted(v) << '\n';
+    }
+
+    auto const input = make(20'000'000);
+
+    auto v1 = input;
+    auto t1 = time([&]() { std::stable_sort(v1.begin(), v1.end()); });
+    std::cout << "std::stable_sort, 20M:       " << t1 << "ms, stable: " << stable_sorted(v1) << '\n';
+
+    auto v2 = input;
+    auto t2 = time([&]() { my::merge_sort(v2.begin(), v2.end()); });
+    std::cout << "my::merge_sort, 20M:         " << t2 << "ms, stable: " << stable_sorted(v2) << '\n';
+
+    // at least 4 workers, so the parallel paths run even on a small machine.
+    work_stealing_pool pool{std::max(4u, std::thread::hardware_concurrency())};
+    auto v3 = input;
+    auto t3 = time([&]() { my::merge_sort(v3.begin(), v3.end(), std::less<>{}, &pool); });
+    std::cout << "my::merge_sort, " << pool.size() << " workers: " << t3 << "ms, stable: " << stable_sorted(v3)
+              << ", same as std::stable_sort: " << (std::equal(v1.begin(), v1.end(), v3.begin(), [](event a, event b) { return a.ts == b.ts && a.seq == b.seq; })) << '\n';
+}
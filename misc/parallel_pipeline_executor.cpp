@@ -0,0 +1,713 @@
+#include <iostream>
+#include <sstream>
+#include <utility>
+#include <type_traits>
+#include <tuple>
+#include <array>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <stdexcept>
+#include <string>
+#include <typeinfo>
+#include <fstream>
+#include <ctime>
+#include <cstdio>
+#include <algorithm>
+
+// building_graph.cpp and guaranteeing_dependency_in_pipeline_1.cpp create the stages one after the other.
+// But B1 and B2 only need A1: once A1 is done, both can run at the same time.
+//
+// The executor below:
+//   1. takes the topological order of the stages (computed at compile time, see building_graph_static_order.cpp),
+//   2. counts, for every stage, how many of its dependencies are still running,
+//   3. submits a stage to a work stealing pool as soon as that count drops to zero.
+//
+// Every run is profiled: per stage wall time, CPU time, time spent waiting for a worker once ready,
+// and output size. From that we get the critical path through the DAG (the chain of stages that
+// decides the total time), and a Chrome trace (open it in chrome://tracing or ui.perfetto.dev).
+
+template <typename... Args>
+struct types_list {};
+
+
+// ------------------------------------------------------------------------------------------------
+// The compile time part: topological order and dependency indices.
+// ------------------------------------------------------------------------------------------------
+
+namespace detail
+{
+
+template <typename T, typename TypeList>
+struct type_exists;
+
+template <typename T, typename... Args>
+struct type_exists<T, types_list<Args...>> : std::bool_constant<(std::is_same_v<T, Args> || ...)> {};
+
+template <typename T, typename TypeList>
+constexpr bool type_exists_v = type_exists<T, TypeList>::value;
+
+
+template <typename T, typename TypeList>
+struct append;
+
+template <typename T, typename... Args>
+struct append<T, types_list<Args...>>
+{
+    using type = types_list<Args..., T>;
+};
+
+
+template <typename T, typename Path, typename Done, bool already_done = type_exists_v<T, Done>>
+struct visit;
+
+template <typename Deps, typename Path, typename Done>
+struct visit_all;
+
+template <typename T, typename Path, typename Done>
+struct visit<T, Path, Done, true>
+{
+    using type = Done;
+};
+
+template <typename T, typename... Path, typename Done>
+struct visit<T, types_list<Path...>, Done, false>
+{
+    static constexpr bool is_cycle = type_exists_v<T, types_list<Path...>>;
+    static_assert(!is_cycle, "depends_on has a cycle");
+
+    using deps = std::conditional_t<is_cycle, std::tuple<>, typename T::depends_on>;
+    using deps_done = typename visit_all<deps, types_list<Path..., T>, Done>::type;
+    using type = typename append<T, deps_done>::type;
+};
+
+template <typename Path, typename Done>
+struct visit_all<std::tuple<>, Path, Done>
+{
+    using type = Done;
+};
+
+template <typename D, typename... Ds, typename Path, typename Done>
+struct visit_all<std::tuple<D, Ds...>, Path, Done>
+{
+    using type = typename visit_all<std::tuple<Ds...>, Path, typename visit<D, Path, Done>::type>::type;
+};
+
+}
+
+template <typename... Ts>
+using topological_order_t = typename detail::visit_all<std::tuple<Ts...>, types_list<>, types_list<>>::type;
+
+
+namespace detail
+{
+    // depends[i][j] is true when stage j is in the depends_on of stage i.
+    template <typename Deps, typename... Ts>
+    struct depends_row;
+
+    template <typename... Ds, typename... Ts>
+    struct depends_row<std::tuple<Ds...>, Ts...>
+    {
+        static constexpr std::array<bool, sizeof...(Ts)> value{type_exists_v<Ts, types_list<Ds...>>...};
+    };
+
+    template <typename... Ts>
+    constexpr std::array<std::array<bool, sizeof...(Ts)>, sizeof...(Ts)> depends_matrix()
+    {
+        return {depends_row<typename Ts::depends_on, Ts...>::value...};
+    }
+
+    // std::apply needs values; a tuple of tags lets us expand depends_on into std::get<D>(...)...
+    template <typename T>
+    struct type_tag { using type = T; };
+
+    template <typename Tuple>
+    struct tags_of;
+
+    template <typename... Ds>
+    struct tags_of<std::tuple<Ds...>>
+    {
+        using type = std::tuple<type_tag<Ds>...>;
+    };
+
+    template <typename Tuple>
+    using tags_of_t = typename tags_of<Tuple>::type;
+
+
+    // A stage may give itself a name (static constexpr char const* name) and report the size of
+    // its output (std::size_t size_bytes() const). Otherwise we use typeid and sizeof.
+    template <typename T, typename = void>
+    struct has_name : std::false_type {};
+
+    template <typename T>
+    struct has_name<T, std::void_t<decltype(T::name)>> : std::true_type {};
+
+    template <typename T, typename = void>
+    struct has_size_bytes : std::false_type {};
+
+    template <typename T>
+    struct has_size_bytes<T, std::void_t<decltype(std::declval<T const&>().size_bytes())>> : std::true_type {};
+
+    template <typename T>
+    std::string stage_name()
+    {
+        if constexpr (has_name<T>::value) { return T::name; }
+        else                              { return typeid(T).name(); }
+    }
+
+    template <typename T>
+    std::size_t output_bytes(T const& stage)
+    {
+        if constexpr (has_size_bytes<T>::value) { return stage.size_bytes(); }
+        else                                    { (void) stage; return sizeof(T); }
+    }
+
+    // CPU time of the calling thread (a stage that sleeps or blocks has wall >> cpu).
+    inline std::chrono::nanoseconds thread_cpu_time()
+    {
+#if defined(CLOCK_THREAD_CPUTIME_ID)
+        timespec ts{};
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+        return std::chrono::seconds{ts.tv_sec} + std::chrono::nanoseconds{ts.tv_nsec};
+#else
+        return std::chrono::nanoseconds{0};
+#endif
+    }
+}
+
+
+// ------------------------------------------------------------------------------------------------
+// A small work stealing pool.
+// Every worker owns a deque: it pushes and pops at the back (the most recent, still hot in cache),
+// and idle workers steal from the front of the others (the oldest, usually the biggest piece of work).
+// ------------------------------------------------------------------------------------------------
+
+class work_stealing_pool
+{
+public:
+    using task_t = std::function<void()>;
+
+    explicit work_stealing_pool(std::size_t n = std::thread::hardware_concurrency())
+        : queues(n == 0 ? 1 : n)
+    {
+        for (std::size_t i{0}; i < queues.size(); ++i)
+        {
+            workers.emplace_back([this, i]() { work(i); });
+        }
+    }
+
+    ~work_stealing_pool()
+    {
+        {
+            std::lock_guard<std::mutex> lock{sleep_mutex};
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& w: workers) { w.join(); }
+    }
+
+    work_stealing_pool(work_stealing_pool const&) = delete;
+    work_stealing_pool& operator=(work_stealing_pool const&) = delete;
+
+    // From a worker, the task goes to its own deque; from the outside, round robin.
+    void submit(task_t task)
+    {
+        std::size_t const q = (current_pool() == this) ? current_worker()
+                                                        : next_queue++ % queues.size();
+        {
+            std::lock_guard<std::mutex> lock{queues[q].mutex};
+            queues[q].tasks.push_back(std::move(task));
+        }
+        {
+            std::lock_guard<std::mutex> lock{sleep_mutex};
+            ++pending;
+        }
+        wake.notify_one();
+    }
+
+    std::size_t size() const { return queues.size(); }
+
+    // The index of the calling worker in its pool, or no_worker outside of any pool.
+    static constexpr std::size_t no_worker = std::size_t(-1);
+    static std::size_t this_worker() { return current_pool() ? current_worker() : no_worker; }
+
+private:
+    struct queue
+    {
+        std::mutex mutex;
+        std::deque<task_t> tasks;
+    };
+
+    // which pool (and which deque) the calling thread works for, if any.
+    static work_stealing_pool const*& current_pool()
+    {
+        thread_local work_stealing_pool const* pool{nullptr};
+        return pool;
+    }
+
+    static std::size_t& current_worker()
+    {
+        thread_local std::size_t index{0};
+        return index;
+    }
+
+    bool pop_local(std::size_t i, task_t& task)
+    {
+        std::lock_guard<std::mutex> lock{queues[i].mutex};
+        if (queues[i].tasks.empty()) { return false; }
+        task = std::move(queues[i].tasks.back());
+        queues[i].tasks.pop_back();
+        return true;
+    }
+
+    bool steal(std::size_t i, task_t& task)
+    {
+        for (std::size_t k{1}; k < queues.size(); ++k)
+        {
+            auto& victim = queues[(i + k) % queues.size()];
+            std::lock_guard<std::mutex> lock{victim.mutex};
+            if (!victim.tasks.empty())
+            {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void work(std::size_t i)
+    {
+        current_pool() = this;
+        current_worker() = i;
+        for (;;)
+        {
+            {
+                // pending counts tasks sitting in some deque: no busy spinning when there is nothing.
+                std::unique_lock<std::mutex> lock{sleep_mutex};
+                wake.wait(lock, [this]() { return stopping || pending > 0; });
+                if (pending == 0) { return; } // stopping, and nothing left.
+                --pending;
+            }
+
+            // We reserved one task; it is in some deque, so keep looking until we get it.
+            task_t task;
+            while (!pop_local(i, task) && !steal(i, task)) { std::this_thread::yield(); }
+            task();
+        }
+    }
+
+    std::vector<queue> queues;
+    std::vector<std::thread> workers;
+    std::atomic<std::size_t> next_queue{0};
+
+    std::mutex sleep_mutex;
+    std::condition_variable wake;
+    std::size_t pending{0};
+    bool stopping{false};
+};
+
+
+// ------------------------------------------------------------------------------------------------
+// Profiling.
+// ------------------------------------------------------------------------------------------------
+
+struct stage_profile
+{
+    using clock = std::chrono::steady_clock;
+
+    std::string name;
+    clock::time_point ready;     // all the dependencies are done.
+    clock::time_point start;     // a worker picked it up.
+    clock::time_point end;
+    std::chrono::nanoseconds cpu{0};
+    std::size_t worker{work_stealing_pool::no_worker};
+    std::size_t output_bytes{0};
+    bool ran{false};
+
+    clock::duration wall() const { return end - start; }
+    clock::duration queue_wait() const { return start - ready; }
+};
+
+struct pipeline_profile
+{
+    using clock = stage_profile::clock;
+
+    clock::time_point begin;
+    clock::time_point end;
+    std::vector<stage_profile> stages;       // in topological order.
+    std::vector<std::size_t> critical_path;  // indices into stages, from the first to the last stage.
+    clock::duration critical_length{};       // wall + queue wait along the critical path.
+
+    void report(std::ostream& os) const
+    {
+        auto us = [](auto d) { return std::chrono::duration_cast<std::chrono::microseconds>(d).count(); };
+
+        os << "stage      wall(us)   cpu(us)  wait(us)     bytes  worker\n";
+        for (auto const& s: stages)
+        {
+            if (!s.ran) { os << s.name << "  (skipped)\n"; continue; }
+            char line[128];
+            std::snprintf(line, sizeof(line), "%-8s %10lld %9lld %9lld %9zu  %6zu\n", s.name.c_str(),
+                          static_cast<long long>(us(s.wall())), static_cast<long long>(us(s.cpu)),
+                          static_cast<long long>(us(s.queue_wait())), s.output_bytes, s.worker);
+            os << line;
+        }
+
+        os << "total: " << us(end - begin) << "us, critical path (" << us(critical_length) << "us): ";
+        for (std::size_t k{0}; k < critical_path.size(); ++k)
+        {
+            os << (k ? " -> " : "") << stages[critical_path[k]].name;
+        }
+        os << '\n';
+    }
+
+    // The Chrome trace event format: one complete ("X") event per stage, one row per worker.
+    void write_chrome_trace(std::ostream& os) const
+    {
+        // a JSON string: quotes, backslashes and control characters escaped.
+        auto json = [](std::string const& str)
+        {
+            std::string out{"\""};
+            for (char c: str)
+            {
+                if ((c == '"') || (c == '\\')) { out += '\\'; out += c; }
+                else if (static_cast<unsigned char>(c) < 0x20)
+                {
+                    char esc[8];
+                    std::snprintf(esc, sizeof(esc), "\\u%04x", static_cast<unsigned>(c));
+                    out += esc;
+                }
+                else { out += c; }
+            }
+            return out + '"';
+        };
+
+        auto us = [&](clock::time_point t) { return std::chrono::duration_cast<std::chrono::microseconds>(t - begin).count(); };
+        auto dus = [](auto d) { return std::chrono::duration_cast<std::chrono::microseconds>(d).count(); };
+
+        os << "{\"traceEvents\":[";
+        bool first = true;
+        for (std::size_t i{0}; i < stages.size(); ++i)
+        {
+            auto const& s = stages[i];
+            if (!s.ran) { continue; }
+            bool const critical = std::find(critical_path.begin(), critical_path.end(), i) != critical_path.end();
+            os << (first ? "" : ",") << "\n"
+               << "{\"name\":" << json(s.name) << ",\"cat\":\"" << (critical ? "critical" : "stage") << "\""
+               << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << s.worker
+               << ",\"ts\":" << us(s.start) << ",\"dur\":" << dus(s.wall())
+               << ",\"args\":{\"cpu_us\":" << dus(s.cpu) << ",\"wait_us\":" << dus(s.queue_wait())
+               << ",\"bytes\":" << s.output_bytes << "}}";
+            first = false;
+        }
+        os << "\n]}\n";
+    }
+};
+
+
+// ------------------------------------------------------------------------------------------------
+// The executor.
+// ------------------------------------------------------------------------------------------------
+
+template <typename TypeList>
+class parallel_pipeline;
+
+template <typename... Ts>
+class parallel_pipeline<types_list<Ts...>>
+{
+public:
+    static constexpr std::size_t N = sizeof...(Ts);
+    static constexpr auto depends = detail::depends_matrix<Ts...>();
+
+    template <typename T>
+    T& get() { return std::get<T>(stages); }
+
+    // Runs every stage once; a stage starts as soon as all its depends_on are done.
+    // If a stage throws, its dependents (direct or not) are skipped, the other stages still run, and the first
+    // exception is rethrown here.
+    void run(work_stealing_pool& pool)
+    {
+        done = 0;
+        error = nullptr;
+        for (auto& f: input_failed) { f.store(false); }
+        begin = stage_profile::clock::now();
+        profile_names(std::index_sequence_for<Ts...>{});
+
+        // All the counters are set before the first submit: a stage that finishes early must not
+        // see a counter we didn't initialize yet.
+        std::array<bool, N> is_root{};
+        for (std::size_t i{0}; i < N; ++i)
+        {
+            std::size_t c{0};
+            for (std::size_t j{0}; j < N; ++j) { c += depends[i][j]; }
+            remaining[i].store(c);
+            is_root[i] = (c == 0);
+        }
+        for (std::size_t i{0}; i < N; ++i)
+        {
+            if (is_root[i]) { submit(pool, i); }
+        }
+
+        std::unique_lock<std::mutex> lock{done_mutex};
+        all_done.wait(lock, [this]() { return done == N; });
+        end = stage_profile::clock::now();
+        if (error) { std::rethrow_exception(error); }
+    }
+
+    // The profile of the last run(), with its critical path.
+    pipeline_profile profile() const
+    {
+        pipeline_profile p{begin, end, {stage_profiles.begin(), stage_profiles.end()}, {}, {}};
+
+        // The longest chain, by (queue wait + wall), through the DAG. The stages are in topological
+        // order, so longest[j] is final by the time we look at it from a dependent i > j.
+        std::array<stage_profile::clock::duration, N> longest{};
+        std::array<std::size_t, N> prev{};
+        std::size_t last{0};
+        for (std::size_t i{0}; i < N; ++i)
+        {
+            prev[i] = N;
+            stage_profile::clock::duration before{};
+            for (std::size_t j{0}; j < i; ++j)
+            {
+                if (depends[i][j] && (longest[j] > before)) { before = longest[j]; prev[i] = j; }
+            }
+            auto const& s = stage_profiles[i];
+            longest[i] = before + (s.ran ? s.queue_wait() + s.wall() : stage_profile::clock::duration{});
+            if (longest[i] > longest[last]) { last = i; }
+        }
+
+        for (std::size_t i = last; i != N; i = prev[i]) { p.critical_path.insert(p.critical_path.begin(), i); }
+        p.critical_length = longest[last];
+        return p;
+    }
+
+private:
+    template <std::size_t... Is>
+    void profile_names(std::index_sequence<Is...>)
+    {
+        ((stage_profiles[Is] = stage_profile{}, stage_profiles[Is].name = detail::stage_name<Ts>()), ...);
+    }
+
+    void submit(work_stealing_pool& pool, std::size_t i)
+    {
+        // Only one thread ever submits stage i (the one that released it), so no lock is needed.
+        // The pool's queue mutex publishes it to the worker.
+        stage_profiles[i].ready = stage_profile::clock::now();
+        pool.submit([this, &pool, i]()
+        {
+            auto& prof = stage_profiles[i];
+            prof.worker = work_stealing_pool::this_worker();
+            auto const cpu0 = detail::thread_cpu_time();
+            prof.start = stage_profile::clock::now();
+            run_stage(i);
+            prof.end = stage_profile::clock::now();
+            prof.cpu = detail::thread_cpu_time() - cpu0;
+            finish(pool, i);
+        });
+    }
+
+    // From a runtime index to the stage type: one branch per stage, expanded by the fold.
+    void run_stage(std::size_t i)
+    {
+        run_stage(i, std::index_sequence_for<Ts...>{});
+    }
+
+    template <std::size_t... Is>
+    void run_stage(std::size_t i, std::index_sequence<Is...>)
+    {
+        if (input_failed[i].load()) { return; }
+        try
+        {
+            ((i == Is ? run_one(std::get<Is>(stages), stage_profiles[Is]) : void()), ...);
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock{done_mutex};
+            if (!error) { error = std::current_exception(); }
+        }
+    }
+
+    // A stage gets its dependencies as const references, in depends_on order.
+    template <typename T>
+    void run_one(T& stage, stage_profile& prof)
+    {
+        std::apply([&](auto... d) { stage.run(std::get<typename decltype(d)::type>(stages)...); },
+                   detail::tags_of_t<typename T::depends_on>{});
+        prof.ran = true;
+        prof.output_bytes = detail::output_bytes(stage);
+    }
+
+    void finish(work_stealing_pool& pool, std::size_t i)
+    {
+        // a stage that threw, or was skipped, has no output: its dependents are skipped in turn. The flag is
+        // set before the fetch_sub, so the thread that releases the dependent sees it.
+        bool const failed = !stage_profiles[i].ran;
+        for (std::size_t k{0}; k < N; ++k)
+        {
+            if (!depends[k][i]) { continue; }
+            if (failed) { input_failed[k].store(true); }
+            // the last dependency to finish is the one that releases the stage.
+            if (remaining[k].fetch_sub(1) == 1) { submit(pool, k); }
+        }
+
+        std::lock_guard<std::mutex> lock{done_mutex};
+        if (++done == N) { all_done.notify_all(); }
+    }
+
+    std::tuple<Ts...> stages;
+    std::array<std::atomic<std::size_t>, N> remaining{};
+
+    std::mutex done_mutex;
+    std::condition_variable all_done;
+    std::size_t done{0};
+    std::array<std::atomic<bool>, N> input_failed{};  // a dependency threw or was skipped.
+    std::exception_ptr error;
+
+    // each entry is written by the one worker that runs the stage; read after run() returns.
+    std::array<stage_profile, N> stage_profiles;
+    stage_profile::clock::time_point begin;
+    stage_profile::clock::time_point end;
+};
+
+template <typename... Ts>
+using parallel_pipeline_for = parallel_pipeline<topological_order_t<Ts...>>;
+
+
+// ------------------------------------------------------------------------------------------------
+// Stages. run() takes the outputs of depends_on. Every stage sleeps to pretend it works.
+// ------------------------------------------------------------------------------------------------
+
+using namespace std::chrono_literals;
+
+std::mutex print_mutex;
+
+void log(char const* what)
+{
+    std::ostringstream os;
+    os << what << " on thread " << std::this_thread::get_id() << '\n';
+    std::lock_guard<std::mutex> lock{print_mutex};
+    std::cout << os.str();
+}
+
+struct A1
+{
+    static constexpr char const* name = "A1";
+    using depends_on = std::tuple<>;
+    void run() { std::this_thread::sleep_for(50ms); value = 1; log("A1"); }
+    int value{0};
+};
+
+struct B1
+{
+    static constexpr char const* name = "B1";
+    using depends_on = std::tuple<A1>;
+    void run(A1 const& a) { std::this_thread::sleep_for(100ms); value = a.value + 10; log("B1"); }
+    int value{0};
+};
+
+struct B2
+{
+    static constexpr char const* name = "B2";
+    using depends_on = std::tuple<A1>;
+    void run(A1 const& a) { std::this_thread::sleep_for(70ms); value = a.value + 20; log("B2"); }
+    int value{0};
+};
+
+struct C1
+{
+    static constexpr char const* name = "C1";
+    using depends_on = std::tuple<B1, B2>;
+    void run(B1 const& b1, B2 const& b2)
+    {
+        // this one really works (wall ~ cpu), where the others only sleep (cpu ~ 0).
+        auto const until = std::chrono::steady_clock::now() + 20ms;
+        while (std::chrono::steady_clock::now() < until) {}
+        value = b1.value + b2.value;
+        log("C1");
+    }
+    int value{0};
+};
+
+
+// A pipeline where one stage throws: Parse fails, so Report (which needs it) is skipped, while Index and Stats,
+// which don't need Parse, still run.
+struct Load
+{
+    static constexpr char const* name = "Load";
+    using depends_on = std::tuple<>;
+    void run() { value = 1; }
+    int value{0};
+};
+
+struct Parse
+{
+    static constexpr char const* name = "Parse";
+    using depends_on = std::tuple<Load>;
+    void run(Load const&) { throw std::runtime_error{"Parse: bad input"}; }
+};
+
+struct Index
+{
+    static constexpr char const* name = "Index";
+    using depends_on = std::tuple<Load>;
+    void run(Load const& l) { std::this_thread::sleep_for(20ms); value = l.value + 1; }
+    int value{0};
+};
+
+struct Stats
+{
+    static constexpr char const* name = "Stats";
+    using depends_on = std::tuple<Index>;
+    void run(Index const& i) { value = i.value * 10; }
+    int value{0};
+};
+
+struct Report
+{
+    static constexpr char const* name = "Report";
+    using depends_on = std::tuple<Parse, Index>;
+    void run(Parse const&, Index const&) {}
+};
+
+
+// With a path argument, the Chrome trace of the first pipeline is written there ("-" for stdout).
+int main(int argc, char** argv)
+{
+    work_stealing_pool pool{4};
+    parallel_pipeline_for<C1> pipeline;
+
+    pipeline.run(pool);
+    std::cout << "C1: " << pipeline.get<C1>().value << '\n'; // C1: 32
+
+    // B1 and B2 ran side by side: about 170ms instead of 240ms.
+    // B1 is the slower branch, so the critical path is A1 -> B1 -> C1: B2 is not worth optimizing.
+    auto profile = pipeline.profile();
+    profile.report(std::cout);
+
+    if (argc > 1)
+    {
+        std::string const path{argv[1]};
+        if (path == "-") { profile.write_chrome_trace(std::cout); }
+        else             { std::ofstream trace{path}; profile.write_chrome_trace(trace); }
+    }
+
+    // A failure only skips the stages downstream of it.
+    parallel_pipeline_for<Report, Stats> failing;
+    try
+    {
+        failing.run(pool);
+    }
+    catch (std::exception const& e)
+    {
+        std::cout << "error: " << e.what() << ", Stats: " << failing.get<Stats>().value << '\n';  // error: Parse: bad input, Stats: 20
+    }
+    failing.profile().report(std::cout);   // Parse and Report: (skipped)
+}
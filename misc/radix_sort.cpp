@@ -0,0 +1,283 @@
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <vector>
+#include <array>
+#include <iterator>
+#include <type_traits>
+#include <limits>
+#include <thread>
+#include <cstdint>
+#include <cstddef>
+#include <chrono>
+#include <random>
+
+// my::join (set_intersection.cpp) needs both inputs sorted on the id, and std::sort is most of the time of a join.
+// The id is an integer: an LSD radix sort orders n records in (bits of the key / 8) passes, O(n) each, no
+// comparison at all.
+//
+// A pass looks at one byte of the key:
+//   1. histogram: how many records have each value of the byte,
+//   2. prefix sum: where the records with each value start in the output,
+//   3. scatter: every record goes to its place (in input order, so the sort is stable, which LSD needs).
+// In parallel, each thread takes a block of the input, counts its own histogram, and scatters its block; the
+// prefix sum goes value by value, then thread by thread, so thread t writes right after thread t - 1 for the
+// same value and nobody writes at the same place. A pass where every record has the same byte (the high bytes
+// of small ids) is skipped. The passes go back and forth between the input and one buffer.
+//
+// The key comes from a key extractor, one overload per record type like the comparators of my::join
+// (key(S), key(M)); key_less(key) turns it into the comparator for my::join. Signed keys are sorted by
+// flipping the sign bit. A key that isn't an integer goes to std::stable_sort.
+
+namespace my
+{
+
+  template <typename Iterator1, typename Iterator2, typename OutIterator, typename Comparator,
+            typename Combiner
+            >
+  OutIterator join(Iterator1 first1, Iterator1 last1,
+                               Iterator2 first2, Iterator2 last2,
+                               OutIterator out_it,
+                               Comparator cmp,
+                               Combiner&& comb)
+  {
+
+    for (auto fixed_f2=first2 ; (first1 != last1) && (fixed_f2 != last2) ; )
+    {
+         if      ((first2 == last2) || cmp(*first1, *first2)) { first1++; first2 = fixed_f2;}
+         else if (cmp(*first2, *first1)) { first2++; fixed_f2 = first2; }
+         else                            { *out_it++ = comb(*first1, *first2++); }
+    }
+    return out_it;
+  }
+
+
+  // The comparator of my::join, from a key extractor: key_less(key)(a, b) is key(a) < key(b), any two types.
+  template <typename Key>
+  auto key_less(Key key)
+  {
+    return [key](auto const& a, auto const& b) { return key(a) < key(b); };
+  }
+
+
+  namespace detail
+  {
+    // The key as an unsigned integer with the same order.
+    template <typename K>
+    auto to_unsigned(K k)
+    {
+      using U = std::make_unsigned_t<K>;
+      if constexpr (std::is_signed_v<K>) { return static_cast<U>(static_cast<U>(k) ^ (U(1) << (std::numeric_limits<U>::digits - 1))); }
+      else                               { return static_cast<U>(k); }
+    }
+
+    constexpr std::size_t radix = 256;
+    using histogram = std::array<std::size_t, radix>;
+
+    // Below this, one thread: starting threads costs more than a pass.
+    constexpr std::size_t parallel_min = 1 << 16;
+
+    template <typename F>
+    void in_parallel(std::size_t threads, F f)
+    {
+      std::vector<std::thread> workers;
+      workers.reserve(threads - 1);
+      for (std::size_t t{1}; t < threads; ++t) { workers.emplace_back(f, t); }
+      f(0);
+      for (auto& w: workers) { w.join(); }
+    }
+
+    template <typename T, typename Key>
+    void lsd_radix_sort(T* data, std::size_t n, Key& key, std::size_t threads)
+    {
+      using key_t = std::decay_t<decltype(key(*data))>;
+      using ukey_t = decltype(to_unsigned(std::declval<key_t>()));
+      constexpr std::size_t passes = sizeof(ukey_t);
+
+      if (n < parallel_min) { threads = 1; }
+      threads = std::max<std::size_t>(1, std::min(threads, n / (parallel_min / 4) + 1));
+
+      std::vector<T> buffer(data, data + n);   // the one allocation (T may have no default constructor).
+      T* from = data;
+      T* to = buffer.data();
+
+      // One histogram per thread and per pass, all counted in a single read of the input.
+      std::vector<std::array<histogram, passes>> counts(threads);
+      auto block = [&](std::size_t t) { return std::pair{n * t / threads, n * (t + 1) / threads}; };
+
+      in_parallel(threads, [&](std::size_t t)
+      {
+        auto& c = counts[t];
+        for (auto& h: c) { h.fill(0); }
+        auto [b, e] = block(t);
+        for (std::size_t i{b}; i < e; ++i)
+        {
+          auto const k = to_unsigned(key(data[i]));
+          for (std::size_t p{0}; p < passes; ++p) { ++c[p][(k >> (8 * p)) & 0xff]; }
+        }
+      });
+
+      // Only the passes whose byte differs somewhere.
+      std::vector<std::size_t> needed;
+      for (std::size_t p{0}; p < passes; ++p)
+      {
+        histogram total{};
+        for (std::size_t t{0}; t < threads; ++t) { for (std::size_t d{0}; d < radix; ++d) { total[d] += counts[t][p][d]; } }
+        if (std::none_of(total.begin(), total.end(), [n](std::size_t c) { return c == n; })) { needed.push_back(p); }
+      }
+
+      std::vector<histogram> offsets(threads);
+      bool reordered{false};
+      for (std::size_t p: needed)
+      {
+        // The blocks of the first pass are blocks of the input: the counts above are theirs. After that, the
+        // blocks hold other records, count again (one read, no write).
+        if (reordered)
+        {
+          in_parallel(threads, [&](std::size_t t)
+          {
+            auto& h = counts[t][p];
+            h.fill(0);
+            auto [b, e] = block(t);
+            for (std::size_t i{b}; i < e; ++i) { ++h[(to_unsigned(key(from[i])) >> (8 * p)) & 0xff]; }
+          });
+        }
+
+        std::size_t sum{0};
+        for (std::size_t d{0}; d < radix; ++d)
+        {
+          for (std::size_t t{0}; t < threads; ++t) { offsets[t][d] = sum; sum += counts[t][p][d]; }
+        }
+
+        in_parallel(threads, [&](std::size_t t)
+        {
+          auto& o = offsets[t];
+          auto [b, e] = block(t);
+          for (std::size_t i{b}; i < e; ++i)
+          {
+            std::size_t const d = (to_unsigned(key(from[i])) >> (8 * p)) & 0xff;
+            to[o[d]++] = std::move(from[i]);
+          }
+        });
+        std::swap(from, to);
+        reordered = true;
+      }
+
+      if (from != data) { std::move(from, from + n, data); }
+    }
+  }
+
+
+  // Sorts [first, last) on key(record), stably. Integer keys: LSD radix sort on `threads` threads (0: one per
+  // core); other keys: std::stable_sort.
+  template <typename Iterator, typename Key>
+  void radix_sort(Iterator first, Iterator last, Key key, std::size_t threads = 0)
+  {
+    using value_type = typename std::iterator_traits<Iterator>::value_type;
+    using key_t = std::decay_t<decltype(key(std::declval<value_type const&>()))>;
+
+    constexpr bool contiguous = std::is_pointer_v<Iterator>
+        || std::is_same_v<Iterator, typename std::vector<value_type>::iterator>;
+
+    if constexpr (std::is_integral_v<key_t> && !std::is_same_v<key_t, bool> && contiguous)
+    {
+      if (last - first < 2) { return; }
+      if (threads == 0) { threads = std::max(1u, std::thread::hardware_concurrency()); }
+      detail::lsd_radix_sort(&*first, static_cast<std::size_t>(last - first), key, threads);
+    }
+    else
+    {
+      std::stable_sort(first, last, key_less(key));
+    }
+  }
+}
+
+
+
+
+
+struct S
+{
+   explicit S(int id_, int v_) : id{id_}, v{v_} {}
+   int id;
+   int v;
+};
+
+
+struct M
+{
+   explicit M(int id_, int v_) : id{id_}, v{v_} {}
+   int id;
+   int v;
+};
+
+std::ostream& operator<<(std::ostream& os, S s) { return os << "S{" << s.id << ", " << s.v << "}"; }
+std::ostream& operator<<(std::ostream& os, M m) { return os << "M{" << m.id << ", " << m.v << "}"; }
+
+// The key of either side; my::key_less(key{}) is the comparator of set_intersection.cpp.
+struct key
+{
+    int operator()(S const& s) const { return s.id; }
+    int operator()(M const& m) const { return m.id; }
+};
+
+// A record with a key that isn't an integer: the fallback.
+struct quote
+{
+    double price;
+    int seq;
+};
+
+
+int main()
+{
+    // The example of set_intersection.cpp, unsorted this time (and negative ids, for the sign bit).
+    std::vector<M> A{M{5,5}, M{2,2}, M{-1,7}, M{2,3}};
+    std::vector<S> B{S{2,1}, S{-1,0}, S{2,4}};
+    my::radix_sort(A.begin(), A.end(), key{});
+    my::radix_sort(B.begin(), B.end(), key{});
+
+    std::vector<std::string> C;
+    my::join(A.cbegin(), A.cend(), B.cbegin(), B.cend(), std::back_inserter(C), my::key_less(key{}),
+             [](M m, S s) { std::ostringstream os; os << m << "-" << s; return os.str(); });
+    std::cout << "C: ";  for (auto c: C) { std::cout << c << ' '; } std::cout << '\n';
+    // This prints: C: M{-1, 7}-S{-1, 0} M{2, 2}-S{2, 1} M{2, 2}-S{2, 4} M{2, 3}-S{2, 1} M{2, 3}-S{2, 4}
+
+    std::vector<quote> quotes{{1.5, 0}, {0.5, 1}, {1.5, 2}, {-2.0, 3}};
+    my::radix_sort(quotes.begin(), quotes.end(), [](quote const& q) { return q.price; });
+    for (auto q: quotes) { std::cout << q.price << '/' << q.seq << ' '; }  // -2/3 0.5/1 1.5/0 1.5/2
+    std::cout << '\n';
+
+
+    // The sort step of a join: 10M records per side.
+    constexpr std::size_t n = 10'000'000;
+    std::mt19937 gen{37};
+    std::uniform_int_distribution<int> pick{-static_cast<int>(n), static_cast<int>(n)};
+    std::vector<M> ms;
+    ms.reserve(n);
+    for (std::size_t i{0}; i < n; ++i) { ms.emplace_back(pick(gen), static_cast<int>(i)); }
+
+    auto time = [](auto f)
+    {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    auto by_std = ms;
+    auto t_std = time([&]() { std::stable_sort(by_std.begin(), by_std.end(), my::key_less(key{})); });
+
+    auto by_radix = ms;
+    auto t_radix = time([&]() { my::radix_sort(by_radix.begin(), by_radix.end(), key{}); });
+
+    auto by_radix4 = ms;
+    auto t_radix4 = time([&]() { my::radix_sort(by_radix4.begin(), by_radix4.end(), key{}, 4); });
+
+    auto same = [&](std::vector<M> const& v)
+    {
+        return std::equal(v.begin(), v.end(), by_std.begin(), [](M const& x, M const& y) { return (x.id == y.id) && (x.v == y.v); });
+    };
+    std::cout << "std::stable_sort:       " << t_std << "ms\n";
+    std::cout << "radix sort:             " << t_radix << "ms" << (same(by_radix) ? "" : " (DIFFERENT)") << '\n';
+    std::cout << "radix sort, 4 threads:  " << t_radix4 << "ms" << (same(by_radix4) ? "" : " (DIFFERENT)") << '\n';
+}
@@ -0,0 +1,565 @@
+#include <iostream>
+#include <algorithm>
+#include <vector>
+#include <array>
+#include <variant>
+#include <iterator>
+#include <utility>
+#include <type_traits>
+#include <cstdint>
+#include <cstddef>
+#include <chrono>
+#include <random>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MY_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+// A set of 32 bit ids as a sorted std::vector costs 4 bytes per id, and my::set_intersection reads all of them.
+// When the set is dense (a third of the ids or more), a bitmap is 1 bit per possible id, and an intersection
+// is an AND of 64 ids at a time (256 with AVX2).
+//
+// Roaring bitmaps pick per chunk of 64K ids (the high 16 bits of the id) the cheaper of three containers:
+//   - array:  the low 16 bits of the ids, sorted; for up to 4096 ids (at most 8KB),
+//   - bitmap: 1024 x 64 bits, always 8KB; for more than 4096 ids,
+//   - run:    (start, length - 1) pairs; for long stretches of consecutive ids (run_optimize() picks them).
+// AND / OR / ANDNOT go chunk by chunk. Two bitmaps are combined word by word and the popcount of the result
+// gives its size; that loop has an AVX2 version, picked at run time (like set_intersection_simd.cpp).
+// A result is stored as an array again when it falls to 4096 ids or less.
+//
+// From and to sorted ranges: roaring::from_sorted(first, last), and begin() / end() walk the ids in order, so
+// a roaring can be an input of the algorithms on sorted ranges (std::set_intersection, my::join, ...) next to a
+// sorted vector.
+
+namespace my
+{
+  namespace detail
+  {
+    constexpr std::size_t chunk_bits = 1 << 16;
+    constexpr std::size_t words = chunk_bits / 64;
+    constexpr std::size_t array_max = 4096;   // above this, a bitmap is smaller than an array.
+
+    struct array_container
+    {
+      std::vector<std::uint16_t> values;
+    };
+
+    struct bitmap_container
+    {
+      std::array<std::uint64_t, words> bits{};
+      std::size_t count{0};
+
+      bool test(std::uint16_t v) const { return (bits[v >> 6] >> (v & 63)) & 1; }
+      void set(std::uint16_t v) { std::uint64_t const m = std::uint64_t(1) << (v & 63); count += !(bits[v >> 6] & m); bits[v >> 6] |= m; }
+      void clear(std::uint16_t v) { std::uint64_t const m = std::uint64_t(1) << (v & 63); count -= !!(bits[v >> 6] & m); bits[v >> 6] &= ~m; }
+    };
+
+    struct run
+    {
+      std::uint16_t start;
+      std::uint16_t length;   // the run is [start, start + length]: length 0 is one id.
+    };
+
+    struct run_container
+    {
+      std::vector<run> runs;
+    };
+
+    using container = std::variant<array_container, bitmap_container, run_container>;
+
+    inline std::size_t cardinality(container const& c)
+    {
+      if (auto a = std::get_if<array_container>(&c)) { return a->values.size(); }
+      if (auto b = std::get_if<bitmap_container>(&c)) { return b->count; }
+      std::size_t n{0};
+      for (auto r: std::get<run_container>(c).runs) { n += std::size_t(r.length) + 1; }
+      return n;
+    }
+
+    inline std::size_t bytes_of(container const& c)
+    {
+      if (auto a = std::get_if<array_container>(&c)) { return a->values.size() * sizeof(std::uint16_t); }
+      if (std::holds_alternative<bitmap_container>(c)) { return sizeof(bitmap_container); }
+      return std::get<run_container>(c).runs.size() * sizeof(run);
+    }
+
+    inline bitmap_container to_bitmap(container const& c)
+    {
+      if (auto b = std::get_if<bitmap_container>(&c)) { return *b; }
+      bitmap_container out;
+      if (auto a = std::get_if<array_container>(&c)) { for (auto v: a->values) { out.set(v); } return out; }
+      for (auto r: std::get<run_container>(c).runs)
+      {
+        for (std::uint32_t v{r.start}; v <= std::uint32_t(r.start) + r.length; ++v) { out.set(static_cast<std::uint16_t>(v)); }
+      }
+      return out;
+    }
+
+    inline array_container to_array(container const& c)
+    {
+      if (auto a = std::get_if<array_container>(&c)) { return *a; }
+      array_container out;
+      out.values.reserve(cardinality(c));
+      if (auto b = std::get_if<bitmap_container>(&c))
+      {
+        for (std::size_t w{0}; w < words; ++w)
+        {
+          for (std::uint64_t bits = b->bits[w]; bits != 0; bits &= bits - 1)
+          {
+            out.values.push_back(static_cast<std::uint16_t>(w * 64 + static_cast<std::size_t>(__builtin_ctzll(bits))));
+          }
+        }
+        return out;
+      }
+      for (auto r: std::get<run_container>(c).runs)
+      {
+        for (std::uint32_t v{r.start}; v <= std::uint32_t(r.start) + r.length; ++v) { out.values.push_back(static_cast<std::uint16_t>(v)); }
+      }
+      return out;
+    }
+
+    // The container a set of n ids should be in, without runs.
+    inline container normalize(bitmap_container&& b)
+    {
+      if (b.count <= array_max) { return to_array(container{std::move(b)}); }
+      return container{std::move(b)};
+    }
+
+    inline container normalize(array_container&& a)
+    {
+      if (a.values.size() > array_max) { return container{to_bitmap(container{std::move(a)})}; }
+      return container{std::move(a)};
+    }
+
+    // run containers take part in the operations as an array or a bitmap, converted into tmp; the others as
+    // they are (no copy of a bitmap on the dense path).
+    inline container const& without_runs(container const& c, container& tmp)
+    {
+      if (!std::holds_alternative<run_container>(c)) { return c; }
+      if (cardinality(c) <= array_max) { tmp = to_array(c); }
+      else                             { tmp = to_bitmap(c); }
+      return tmp;
+    }
+
+
+    // ---------------------------------------------------------------------------------------------
+    // bitmap op bitmap: the hot loop.
+    // ---------------------------------------------------------------------------------------------
+
+    enum class op { and_, or_, andnot };
+
+    template <op o>
+    std::uint64_t apply_word(std::uint64_t a, std::uint64_t b)
+    {
+      if constexpr (o == op::and_) { return a & b; }
+      else if constexpr (o == op::or_) { return a | b; }
+      else { return a & ~b; }
+    }
+
+    template <op o>
+    std::size_t bitmap_op_scalar(std::uint64_t const* a, std::uint64_t const* b, std::uint64_t* out)
+    {
+      std::size_t count{0};
+      for (std::size_t w{0}; w < words; ++w)
+      {
+        out[w] = apply_word<o>(a[w], b[w]);
+        count += static_cast<std::size_t>(__builtin_popcountll(out[w]));
+      }
+      return count;
+    }
+
+#if defined(MY_SIMD_X86)
+    template <op o>
+    __attribute__((target("avx2,popcnt")))
+    std::size_t bitmap_op_avx2(std::uint64_t const* a, std::uint64_t const* b, std::uint64_t* out)
+    {
+      std::size_t count{0};
+      for (std::size_t w{0}; w < words; w += 4)
+      {
+        __m256i const va = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(a + w));
+        __m256i const vb = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(b + w));
+        __m256i r;
+        if constexpr (o == op::and_)     { r = _mm256_and_si256(va, vb); }
+        else if constexpr (o == op::or_) { r = _mm256_or_si256(va, vb); }
+        else                             { r = _mm256_andnot_si256(vb, va); }  // ~vb & va
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + w), r);
+        count += static_cast<std::size_t>(_mm_popcnt_u64(static_cast<std::uint64_t>(_mm256_extract_epi64(r, 0))))
+               + static_cast<std::size_t>(_mm_popcnt_u64(static_cast<std::uint64_t>(_mm256_extract_epi64(r, 1))))
+               + static_cast<std::size_t>(_mm_popcnt_u64(static_cast<std::uint64_t>(_mm256_extract_epi64(r, 2))))
+               + static_cast<std::size_t>(_mm_popcnt_u64(static_cast<std::uint64_t>(_mm256_extract_epi64(r, 3))));
+      }
+      return count;
+    }
+#endif
+
+    template <op o>
+    using bitmap_kernel_t = std::size_t (*)(std::uint64_t const*, std::uint64_t const*, std::uint64_t*);
+
+    template <op o>
+    bitmap_kernel_t<o> pick_bitmap_kernel()
+    {
+#if defined(MY_SIMD_X86)
+      __builtin_cpu_init();
+      if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) { return &bitmap_op_avx2<o>; }
+#endif
+      return &bitmap_op_scalar<o>;
+    }
+
+    template <op o>
+    bitmap_container bitmap_op(bitmap_container const& a, bitmap_container const& b)
+    {
+      static bitmap_kernel_t<o> const kernel = pick_bitmap_kernel<o>();
+      bitmap_container out;
+      out.count = kernel(a.bits.data(), b.bits.data(), out.bits.data());
+      return out;
+    }
+
+
+    // ---------------------------------------------------------------------------------------------
+    // container op container.
+    // ---------------------------------------------------------------------------------------------
+
+    template <op o>
+    container apply(container const& x, container const& y)
+    {
+      container tmp_a, tmp_b;
+      container const& a = without_runs(x, tmp_a);
+      container const& b = without_runs(y, tmp_b);
+      auto const* aa = std::get_if<array_container>(&a);
+      auto const* ab = std::get_if<bitmap_container>(&a);
+      auto const* ba = std::get_if<array_container>(&b);
+      auto const* bb = std::get_if<bitmap_container>(&b);
+
+      if (ab && bb) { return normalize(bitmap_op<o>(*ab, *bb)); }
+
+      if constexpr (o == op::and_)
+      {
+        array_container out;
+        if (aa && ba)
+        {
+          std::set_intersection(aa->values.begin(), aa->values.end(), ba->values.begin(), ba->values.end(), std::back_inserter(out.values));
+        }
+        else
+        {
+          // the array side, filtered by the bitmap side.
+          auto const& arr = aa ? *aa : *ba;
+          auto const& bmp = ab ? *ab : *bb;
+          std::copy_if(arr.values.begin(), arr.values.end(), std::back_inserter(out.values), [&](std::uint16_t v) { return bmp.test(v); });
+        }
+        return container{std::move(out)};
+      }
+      else if constexpr (o == op::or_)
+      {
+        if (aa && ba)
+        {
+          array_container out;
+          std::set_union(aa->values.begin(), aa->values.end(), ba->values.begin(), ba->values.end(), std::back_inserter(out.values));
+          return normalize(std::move(out));
+        }
+        bitmap_container out = ab ? *ab : *bb;
+        for (auto v: (aa ? *aa : *ba).values) { out.set(v); }
+        return container{std::move(out)};
+      }
+      else
+      {
+        if (aa)
+        {
+          array_container out;
+          if (ba) { std::set_difference(aa->values.begin(), aa->values.end(), ba->values.begin(), ba->values.end(), std::back_inserter(out.values)); }
+          else    { std::copy_if(aa->values.begin(), aa->values.end(), std::back_inserter(out.values), [&](std::uint16_t v) { return !bb->test(v); }); }
+          return container{std::move(out)};
+        }
+        bitmap_container out = *ab;
+        for (auto v: ba->values) { out.clear(v); }
+        return normalize(std::move(out));
+      }
+    }
+  }
+
+
+  class roaring
+  {
+  public:
+    using value_type = std::uint32_t;
+
+    roaring() = default;
+
+    // From a sorted range of ids (duplicates are fine).
+    template <typename Iterator>
+    static roaring from_sorted(Iterator first, Iterator last)
+    {
+      roaring r;
+      while (first != last)
+      {
+        std::uint16_t const key = static_cast<std::uint16_t>(static_cast<std::uint32_t>(*first) >> 16);
+        detail::array_container a;
+        for ( ; (first != last) && ((static_cast<std::uint32_t>(*first) >> 16) == key); ++first)
+        {
+          auto const low = static_cast<std::uint16_t>(*first);
+          if (a.values.empty() || (a.values.back() != low)) { a.values.push_back(low); }
+        }
+        r.chunks.push_back({key, detail::normalize(std::move(a))});
+      }
+      return r;
+    }
+
+    bool contains(std::uint32_t id) const
+    {
+      auto const key = static_cast<std::uint16_t>(id >> 16);
+      auto const low = static_cast<std::uint16_t>(id);
+      auto it = std::lower_bound(chunks.begin(), chunks.end(), key, [](auto const& c, std::uint16_t k) { return c.key < k; });
+      if ((it == chunks.end()) || (it->key != key)) { return false; }
+      auto const& c = it->c;
+      if (auto a = std::get_if<detail::array_container>(&c)) { return std::binary_search(a->values.begin(), a->values.end(), low); }
+      if (auto b = std::get_if<detail::bitmap_container>(&c)) { return b->test(low); }
+      auto const& runs = std::get<detail::run_container>(c).runs;
+      auto r = std::upper_bound(runs.begin(), runs.end(), low, [](std::uint16_t v, detail::run const& x) { return v < x.start; });
+      return (r != runs.begin()) && (low <= std::uint32_t(std::prev(r)->start) + std::prev(r)->length);
+    }
+
+    std::size_t size() const
+    {
+      std::size_t n{0};
+      for (auto const& c: chunks) { n += detail::cardinality(c.c); }
+      return n;
+    }
+
+    // The bytes of the containers (the chunk index aside).
+    std::size_t bytes() const
+    {
+      std::size_t n{0};
+      for (auto const& c: chunks) { n += detail::bytes_of(c.c); }
+      return n;
+    }
+
+    // Stores every chunk as runs where that's smaller than its array or bitmap.
+    void run_optimize()
+    {
+      for (auto& ch: chunks)
+      {
+        if (std::holds_alternative<detail::run_container>(ch.c)) { continue; }
+        detail::run_container rc;
+        auto const values = detail::to_array(ch.c).values;
+        for (std::size_t i{0}; i < values.size(); )
+        {
+          std::size_t j{i};
+          while ((j + 1 < values.size()) && (values[j + 1] == values[j] + 1)) { ++j; }
+          rc.runs.push_back({values[i], static_cast<std::uint16_t>(j - i)});
+          i = j + 1;
+        }
+        if (rc.runs.size() * sizeof(detail::run) < detail::bytes_of(ch.c)) { ch.c = std::move(rc); }
+      }
+    }
+
+    friend roaring operator&(roaring const& a, roaring const& b) { return combine<detail::op::and_>(a, b); }
+    friend roaring operator|(roaring const& a, roaring const& b) { return combine<detail::op::or_>(a, b); }
+    friend roaring andnot(roaring const& a, roaring const& b)    { return combine<detail::op::andnot>(a, b); }
+
+
+    // The ids in increasing order.
+    class const_iterator
+    {
+    public:
+      using value_type        = std::uint32_t;
+      using reference         = std::uint32_t;
+      using pointer           = void;
+      using difference_type   = std::ptrdiff_t;
+      using iterator_category = std::forward_iterator_tag;
+
+      const_iterator() = default;
+      const_iterator(roaring const* r_, std::size_t chunk_) : r{r_}, chunk{chunk_} { settle(); }
+
+      std::uint32_t operator*() const { return (std::uint32_t(r->chunks[chunk].key) << 16) | low; }
+
+      const_iterator& operator++()
+      {
+        ++pos;
+        settle();
+        return *this;
+      }
+      const_iterator operator++(int) { auto tmp = *this; ++*this; return tmp; }
+
+      friend bool operator==(const_iterator const& x, const_iterator const& y) { return (x.chunk == y.chunk) && (x.pos == y.pos); }
+      friend bool operator!=(const_iterator const& x, const_iterator const& y) { return !(x == y); }
+
+    private:
+      // pos counts the ids already passed in the current chunk; settle finds the id number pos, or moves to
+      // the next chunk. Each container keeps a cursor (array index, bitmap word, run) so it is O(1) amortized.
+      void settle()
+      {
+        for ( ; chunk < r->chunks.size(); ++chunk, pos = 0, word = 0, bits = 0, run = 0, run_offset = 0)
+        {
+          auto const& c = r->chunks[chunk].c;
+          if (auto a = std::get_if<detail::array_container>(&c))
+          {
+            if (pos < a->values.size()) { low = a->values[pos]; return; }
+          }
+          else if (auto b = std::get_if<detail::bitmap_container>(&c))
+          {
+            if (pos == 0) { word = 0; bits = b->bits[0]; }
+            while ((bits == 0) && (++word < detail::words)) { bits = b->bits[word]; }
+            if (word < detail::words)
+            {
+              low = static_cast<std::uint16_t>(word * 64 + static_cast<std::size_t>(__builtin_ctzll(bits)));
+              bits &= bits - 1;
+              return;
+            }
+          }
+          else
+          {
+            auto const& runs = std::get<detail::run_container>(c).runs;
+            if (pos > 0) { if (++run_offset > runs[run].length) { ++run; run_offset = 0; } }
+            if (run < runs.size()) { low = static_cast<std::uint16_t>(runs[run].start + run_offset); return; }
+          }
+        }
+        pos = 0;
+      }
+
+      roaring const* r{nullptr};
+      std::size_t chunk{0};
+      std::size_t pos{0};
+      std::uint16_t low{0};
+      std::size_t word{0};
+      std::uint64_t bits{0};
+      std::size_t run{0};
+      std::size_t run_offset{0};
+    };
+
+    const_iterator begin() const { return {this, 0}; }
+    const_iterator end() const { return {this, chunks.size()}; }
+
+    std::vector<std::uint32_t> to_vector() const
+    {
+      std::vector<std::uint32_t> v;
+      v.reserve(size());
+      v.assign(begin(), end());
+      return v;
+    }
+
+  private:
+    struct chunk
+    {
+      std::uint16_t key;
+      detail::container c;
+    };
+
+    template <detail::op o>
+    static roaring combine(roaring const& a, roaring const& b)
+    {
+      roaring out;
+      auto i = a.chunks.begin();
+      auto j = b.chunks.begin();
+      auto keep = [&](std::uint16_t key, detail::container&& c)
+      {
+        if (detail::cardinality(c) > 0) { out.chunks.push_back({key, std::move(c)}); }
+      };
+
+      // the chunk keys are sorted: one more merge.
+      while ((i != a.chunks.end()) || (j != b.chunks.end()))
+      {
+        if ((j == b.chunks.end()) || ((i != a.chunks.end()) && (i->key < j->key)))
+        {
+          if constexpr (o != detail::op::and_) { keep(i->key, detail::container{i->c}); }
+          ++i;
+        }
+        else if ((i == a.chunks.end()) || (j->key < i->key))
+        {
+          if constexpr (o == detail::op::or_) { keep(j->key, detail::container{j->c}); }
+          ++j;
+        }
+        else
+        {
+          keep(i->key, detail::apply<o>(i->c, j->c));
+          ++i;
+          ++j;
+        }
+      }
+      return out;
+    }
+
+    std::vector<chunk> chunks;   // sorted by key
+  };
+}
+
+
+int main()
+{
+    // small sets, every kind of container: a few ids, a dense chunk, a run.
+    std::vector<std::uint32_t> xs{1, 5, 70'000, 70'001, 70'002};
+    for (std::uint32_t v{200'000}; v < 210'000; v += 2) { xs.push_back(v); }   // 5000 ids in chunk 3: a bitmap
+    std::vector<std::uint32_t> ys{5, 70'001, 131'072};
+    for (std::uint32_t v{200'000}; v < 220'000; ++v) { ys.push_back(v); }       // a run
+
+    auto x = my::roaring::from_sorted(xs.begin(), xs.end());
+    auto y = my::roaring::from_sorted(ys.begin(), ys.end());
+    y.run_optimize();
+    std::cout << "x: " << x.size() << " ids in " << x.bytes() << " bytes, y: " << y.size() << " ids in " << y.bytes() << " bytes\n";
+
+    auto both = x & y;
+    std::cout << "x & y: " << both.size() << " ids, first ones: ";
+    int shown{0};
+    for (auto id: both) { if (shown++ == 4) { break; } std::cout << id << ' '; }   // 5 70001 200000 200002
+    std::cout << '\n';
+    std::cout << "x | y: " << (x | y).size() << " ids, x - y: " << andnot(x, y).size() << " ids\n";  // 20006, 3
+    std::cout << "contains 70002: " << x.contains(70'002) << ", 70003: " << x.contains(70'003) << '\n';
+
+    // A roaring next to a sorted vector, in an algorithm on sorted ranges.
+    std::vector<std::uint32_t> wanted{1, 2, 70'002, 200'004, 200'005};
+    std::vector<std::uint32_t> found;
+    std::set_intersection(x.begin(), x.end(), wanted.begin(), wanted.end(), std::back_inserter(found));
+    for (auto id: found) { std::cout << id << ' '; }   // 1 70002 200004
+    std::cout << '\n';
+
+    // Check every operation against the algorithms on sorted vectors.
+    auto check = [](char const* name, my::roaring const& r, std::vector<std::uint32_t> const& expected)
+    {
+        bool const same = (r.to_vector() == expected) && (r.size() == expected.size());
+        if (!same) { std::cout << name << " DIFFERENT\n"; }
+        return same;
+    };
+
+    // Segment membership sets over 10M ids, 30% to 80% dense.
+    constexpr std::uint32_t universe = 10'000'000;
+    std::mt19937 gen{41};
+    auto make = [&](double density)
+    {
+        std::bernoulli_distribution in{density};
+        std::vector<std::uint32_t> v;
+        for (std::uint32_t id{0}; id < universe; ++id) { if (in(gen)) { v.push_back(id); } }
+        return v;
+    };
+
+    auto time = [](auto f)
+    {
+        auto start = std::chrono::steady_clock::now();
+        auto r = f();
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+        return std::pair{std::move(r), us};
+    };
+
+    for (auto [da, db]: {std::pair{0.3, 0.3}, std::pair{0.5, 0.8}, std::pair{0.8, 0.8}, std::pair{0.001, 0.5}})
+    {
+        auto const va = make(da);
+        auto const vb = make(db);
+        auto const ra = my::roaring::from_sorted(va.begin(), va.end());
+        auto const rb = my::roaring::from_sorted(vb.begin(), vb.end());
+
+        auto [vi, t_vec] = time([&]()
+        {
+            std::vector<std::uint32_t> out;
+            std::set_intersection(va.begin(), va.end(), vb.begin(), vb.end(), std::back_inserter(out));
+            return out;
+        });
+        auto [ri, t_roaring] = time([&]() { return ra & rb; });
+
+        std::vector<std::uint32_t> vu, vd;
+        std::set_union(va.begin(), va.end(), vb.begin(), vb.end(), std::back_inserter(vu));
+        std::set_difference(va.begin(), va.end(), vb.begin(), vb.end(), std::back_inserter(vd));
+        bool const ok = check("and", ri, vi) && check("or", ra | rb, vu) && check("andnot", andnot(ra, rb), vd);
+
+        std::cout << "density " << da << " & " << db << ": sorted vectors " << t_vec << "us ("
+                  << (va.size() + vb.size()) * 4 / 1024 << "KB), roaring " << t_roaring << "us ("
+                  << (ra.bytes() + rb.bytes()) / 1024 << "KB)" << (ok ? "" : " (DIFFERENT)") << '\n';
+    }
+}
@@ -0,0 +1,278 @@
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <vector>
+#include <iterator>
+#include <type_traits>
+#include <chrono>
+#include <random>
+
+// my::set_intersection and my::join (set_intersection.cpp) move one element at a time on the smaller side.
+// Intersecting 1k keys with 100M keys costs ~100M steps, even though there are at most 1k matches.
+//
+// Galloping (exponential search): when *first1 < *first2, instead of ++first1, jump first1 by 1, 2, 4, 8, ...
+// until we pass *first2, then binary search the last jump. Skipping k elements costs O(log k), so the
+// whole intersection is O(m log(n/m)) for m << n.
+//
+// Galloping has a higher constant per step, so for inputs of similar sizes the linear merge is still
+// better. The adaptive versions pick one or the other from the size ratio.
+
+namespace my
+{
+
+  template <typename Iterator1, typename Iterator2, typename OutIterator, typename Comparator,
+            typename Combiner
+            >
+  OutIterator set_intersection(Iterator1 first1, Iterator1 last1,
+                               Iterator2 first2, Iterator2 last2,
+                               OutIterator out_it,
+                               Comparator cmp,
+                               Combiner&& comb)
+  {
+
+    for ( ; (first1 != last1) && (first2 != last2) ; )
+    {
+         if      (cmp(*first1, *first2)) { first1++; }
+         else if (cmp(*first2, *first1)) { first2++; }
+         else                            { *out_it++ = comb(*first1++, *first2++); }
+    }
+    return out_it;
+  }
+
+
+
+  template <typename Iterator1, typename Iterator2, typename OutIterator, typename Comparator,
+            typename Combiner
+            >
+  OutIterator join(Iterator1 first1, Iterator1 last1,
+                               Iterator2 first2, Iterator2 last2,
+                               OutIterator out_it,
+                               Comparator cmp,
+                               Combiner&& comb)
+  {
+
+    for (auto fixed_f2=first2 ; (first1 != last1) && (fixed_f2 != last2) ; )
+    {
+         if      ((first2 == last2) || cmp(*first1, *first2)) { first1++; first2 = fixed_f2;}
+         else if (cmp(*first2, *first1)) { first2++; fixed_f2 = first2; }
+         else                            { *out_it++ = comb(*first1, *first2++); }
+    }
+    return out_it;
+  }
+
+
+  namespace detail
+  {
+    // The first element in [first, last) that is not less than value.
+    // Because the comparator is heterogeneous (cmp(S, M) and cmp(M, S)), value can be of another type.
+    template <typename Iterator, typename T, typename Comparator>
+    Iterator gallop(Iterator first, Iterator last, T const& value, Comparator& cmp)
+    {
+      using diff_t = typename std::iterator_traits<Iterator>::difference_type;
+
+      diff_t const n = last - first;
+      diff_t lo{0};    // first + lo is known to be less than value (or lo == 0).
+      diff_t hi{1};
+      while ((hi < n) && cmp(first[hi], value)) { lo = hi; hi *= 2; }
+      if (hi > n) { hi = n; }
+
+      return std::lower_bound(first + lo, first + hi, value,
+                              [&](auto const& e, auto const& v) { return cmp(e, v); });
+    }
+
+    template <typename Iterator>
+    constexpr bool is_random_access_v =
+        std::is_base_of_v<std::random_access_iterator_tag, typename std::iterator_traits<Iterator>::iterator_category>;
+
+    // Past this size ratio, galloping wins (measured with the benchmark in main; it's not very sensitive).
+    constexpr std::size_t gallop_ratio = 16;
+
+    template <typename Iterator1, typename Iterator2>
+    bool should_gallop(Iterator1 first1, Iterator1 last1, Iterator2 first2, Iterator2 last2)
+    {
+      if constexpr (is_random_access_v<Iterator1> && is_random_access_v<Iterator2>)
+      {
+        auto const n1 = static_cast<std::size_t>(last1 - first1);
+        auto const n2 = static_cast<std::size_t>(last2 - first2);
+        return (std::min(n1, n2) * gallop_ratio) < std::max(n1, n2);
+      }
+      else
+      {
+        return false;
+      }
+    }
+  }
+
+
+  // Both sides gallop: whichever side is behind jumps ahead to the other side's current key.
+  // So it does not matter which of the two inputs is the small one.
+  template <typename Iterator1, typename Iterator2, typename OutIterator, typename Comparator,
+            typename Combiner
+            >
+  OutIterator galloping_set_intersection(Iterator1 first1, Iterator1 last1,
+                                         Iterator2 first2, Iterator2 last2,
+                                         OutIterator out_it,
+                                         Comparator cmp,
+                                         Combiner&& comb)
+  {
+    static_assert(detail::is_random_access_v<Iterator1> && detail::is_random_access_v<Iterator2>,
+                  "galloping needs random access iterators");
+
+    for ( ; (first1 != last1) && (first2 != last2) ; )
+    {
+         if      (cmp(*first1, *first2)) { first1 = detail::gallop(first1, last1, *first2, cmp); }
+         else if (cmp(*first2, *first1)) { first2 = detail::gallop(first2, last2, *first1, cmp); }
+         else                            { *out_it++ = comb(*first1++, *first2++); }
+    }
+    return out_it;
+  }
+
+
+  // Same output as my::join (every pair of equal keys), but the gaps between the runs are galloped over.
+  template <typename Iterator1, typename Iterator2, typename OutIterator, typename Comparator,
+            typename Combiner
+            >
+  OutIterator galloping_join(Iterator1 first1, Iterator1 last1,
+                             Iterator2 first2, Iterator2 last2,
+                             OutIterator out_it,
+                             Comparator cmp,
+                             Combiner&& comb)
+  {
+    static_assert(detail::is_random_access_v<Iterator1> && detail::is_random_access_v<Iterator2>,
+                  "galloping needs random access iterators");
+
+    for ( ; (first1 != last1) && (first2 != last2) ; )
+    {
+         if      (cmp(*first1, *first2)) { first1 = detail::gallop(first1, last1, *first2, cmp); }
+         else if (cmp(*first2, *first1)) { first2 = detail::gallop(first2, last2, *first1, cmp); }
+         else
+         {
+           // the run of equal keys on the right is emitted for *first1; first2 stays at the start of the
+           // run, because the next left element may have the same key.
+           for (auto it = first2; (it != last2) && !cmp(*first1, *it); ++it) { *out_it++ = comb(*first1, *it); }
+           ++first1;
+         }
+    }
+    return out_it;
+  }
+
+
+  // Picks the linear merge or galloping from the sizes of the inputs.
+  template <typename Iterator1, typename Iterator2, typename OutIterator, typename Comparator,
+            typename Combiner
+            >
+  OutIterator adaptive_set_intersection(Iterator1 first1, Iterator1 last1,
+                                        Iterator2 first2, Iterator2 last2,
+                                        OutIterator out_it,
+                                        Comparator cmp,
+                                        Combiner&& comb)
+  {
+    if constexpr (detail::is_random_access_v<Iterator1> && detail::is_random_access_v<Iterator2>)
+    {
+      if (detail::should_gallop(first1, last1, first2, last2))
+      {
+        return galloping_set_intersection(first1, last1, first2, last2, out_it, cmp, std::forward<Combiner>(comb));
+      }
+    }
+    return set_intersection(first1, last1, first2, last2, out_it, cmp, std::forward<Combiner>(comb));
+  }
+
+  template <typename Iterator1, typename Iterator2, typename OutIterator, typename Comparator,
+            typename Combiner
+            >
+  OutIterator adaptive_join(Iterator1 first1, Iterator1 last1,
+                            Iterator2 first2, Iterator2 last2,
+                            OutIterator out_it,
+                            Comparator cmp,
+                            Combiner&& comb)
+  {
+    if constexpr (detail::is_random_access_v<Iterator1> && detail::is_random_access_v<Iterator2>)
+    {
+      if (detail::should_gallop(first1, last1, first2, last2))
+      {
+        return galloping_join(first1, last1, first2, last2, out_it, cmp, std::forward<Combiner>(comb));
+      }
+    }
+    return join(first1, last1, first2, last2, out_it, cmp, std::forward<Combiner>(comb));
+  }
+}
+
+
+
+
+
+struct S
+{
+   explicit S(int id_, int v_) : id{id_}, v{v_} {}
+   int id;
+   int v;
+};
+
+
+struct M
+{
+   explicit M(int id_, int v_) : id{id_}, v{v_} {}
+   int id;
+   int v;
+};
+
+std::ostream& operator<<(std::ostream& os, S s) { return os << "S{" << s.id << ", " << s.v << "}"; }
+std::ostream& operator<<(std::ostream& os, M m) { return os << "M{" << m.id << ", " << m.v << "}"; }
+
+struct cmp
+{
+    bool operator()(S s, M m) { return s.id < m.id; }
+    bool operator()(M m, S s) { return m.id < s.id; }
+};
+
+
+int main()
+{
+    // The example of set_intersection.cpp, through galloping_join: the same output.
+    std::vector<M> A{M{2,2},M{2,3}, M{5,5}};
+    std::vector<S> B{S{2,1},S{2,4}};
+    std::vector<std::string> C;
+
+    auto comb = [](M m, S s)
+    {
+        std::ostringstream os;
+        os <<  m << "-" << s;
+        return os.str();
+    };
+
+    my::galloping_join(std::cbegin(A), std::cend(A),
+                       std::cbegin(B), std::cend(B),
+                       std::back_inserter(C),
+                       cmp{}, comb);
+
+    std::cout << "C: ";  for (auto c: C) { std::cout << c << ' '; } std::cout << '\n';
+    // This prints: C: M{2, 2}-S{2, 1} M{2, 2}-S{2, 4} M{2, 3}-S{2, 1} M{2, 3}-S{2, 4}
+
+
+    // small against huge: 1k keys against 20M keys.
+    std::mt19937 gen{1};
+    std::vector<M> huge;
+    huge.reserve(20'000'000);
+    for (int i{0}; i < 20'000'000; ++i) { huge.emplace_back(2 * i, i); }  // even ids.
+
+    std::vector<S> small;
+    std::uniform_int_distribution<int> pick{0, 40'000'000};
+    for (int i{0}; i < 1000; ++i) { small.emplace_back(pick(gen), i); }
+    std::sort(small.begin(), small.end(), [](S a, S b) { return a.id < b.id; });
+
+    auto count_comb = [](M const&, S const&) { return 1; };
+
+    auto bench = [&](char const* name, auto algo)
+    {
+        std::vector<int> out;
+        auto start = std::chrono::steady_clock::now();
+        algo(huge.cbegin(), huge.cend(), small.cbegin(), small.cend(), std::back_inserter(out), cmp{}, count_comb);
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+        std::cout << name << out.size() << " matches in " << us << "us\n";
+    };
+
+    bench("linear:         ", [](auto... args) { return my::set_intersection(args...); });
+    bench("galloping:      ", [](auto... args) { return my::galloping_set_intersection(args...); });
+    bench("adaptive:       ", [](auto... args) { return my::adaptive_set_intersection(args...); });
+    bench("adaptive join:  ", [](auto... args) { return my::adaptive_join(args...); });
+}
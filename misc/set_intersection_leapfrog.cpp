@@ -0,0 +1,292 @@
+#include <iostream>
+#include <algorithm>
+#include <vector>
+#include <tuple>
+#include <utility>
+#include <iterator>
+#include <numeric>
+#include <functional>
+#include <chrono>
+#include <random>
+
+// Intersecting K sorted sets with my::set_intersection is K - 1 passes, and every pass but the last writes a
+// temporary set that the next pass reads back.
+//
+// Leapfrog intersection does all the sets at once, with one cursor per set and no temporary:
+//   - the driver (the smallest set) proposes its current key x,
+//   - every other cursor seeks (gallops) to the first key not less than x,
+//   - if one of them lands on a bigger key y, x is not in the intersection: the driver seeks to y, and we
+//     start again from the new x,
+//   - if all of them land on x, x is a match.
+// A cursor only ever moves forward, and with galloping a seek over k keys is O(log k), so the cost follows the
+// small sets, not the big ones. A seek always compares the driver with one other set, so the heterogeneous
+// comparator of my::set_intersection is all we need (cmp(S, M) and cmp(M, S); no cmp(M, M)).
+//
+// Matches come one at a time (next()), nothing is materialized unless the caller does it.
+//   - leapfrog<Cmp, It0, Its...>: one range per type; the first range is the driver, so pass the smallest first.
+//   - leapfrog_n<Cmp, It>: any number of ranges of the same type (posting lists); it sorts them by size itself,
+//     the smallest drives and the others are tried from the smallest up (the small ones reject x more often).
+// The inputs are sets: sorted, and no duplicates.
+
+namespace my
+{
+  namespace detail
+  {
+    // The first element in [first, last) that is not less than value: exponential search, then binary search.
+    template <typename Iterator, typename T, typename Comparator>
+    Iterator gallop(Iterator first, Iterator last, T const& value, Comparator& cmp)
+    {
+      using diff_t = typename std::iterator_traits<Iterator>::difference_type;
+
+      diff_t const n = last - first;
+      diff_t lo{0};
+      diff_t hi{1};
+      if ((n == 0) || !cmp(*first, value)) { return first; }
+      while ((hi < n) && cmp(first[hi], value)) { lo = hi; hi *= 2; }
+      if (hi > n) { hi = n; }
+
+      return std::lower_bound(first + lo, first + hi, value,
+                              [&](auto const& e, auto const& v) { return cmp(e, v); });
+    }
+
+    template <typename Iterator>
+    struct cursor
+    {
+      Iterator first;
+      Iterator last;
+    };
+
+    enum class seek_result { match, overshoot, exhausted };
+
+    // Moves `other` to the first key not less than *driver.first.
+    template <typename Iterator, typename DriverIterator, typename Comparator>
+    seek_result seek(cursor<Iterator>& other, cursor<DriverIterator> const& driver, Comparator& cmp)
+    {
+      other.first = gallop(other.first, other.last, *driver.first, cmp);
+      if (other.first == other.last)       { return seek_result::exhausted; }
+      if (cmp(*driver.first, *other.first)) { return seek_result::overshoot; }
+      return seek_result::match;
+    }
+
+    // What to do with the result of a seek. Returns true when the driver moved (to a new key, or to its end
+    // when a set is exhausted), false when x is in this set too (keep going with the next set).
+    template <typename Iterator, typename DriverIterator, typename Comparator>
+    bool leap(seek_result r, cursor<Iterator> const& other, cursor<DriverIterator>& driver, Comparator& cmp)
+    {
+      if (r == seek_result::exhausted) { driver.first = driver.last; return true; }
+      if (r == seek_result::overshoot) { driver.first = gallop(driver.first, driver.last, *other.first, cmp); return true; }
+      return false;
+    }
+  }
+
+
+  template <typename Comparator, typename DriverIterator, typename... Iterators>
+  class leapfrog
+  {
+  public:
+    leapfrog(Comparator cmp_, std::pair<DriverIterator, DriverIterator> driver_, std::pair<Iterators, Iterators>... others_)
+      : cmp{cmp_}, driver{driver_.first, driver_.second}, others{detail::cursor<Iterators>{others_.first, others_.second}...}
+    {}
+
+    // Moves to the next key that is in every range. false when there are no more.
+    bool next()
+    {
+      if (started && (driver.first != driver.last)) { ++driver.first; }
+      started = true;
+
+      while (driver.first != driver.last)
+      {
+        // every other set in turn, until one of them moves the driver (the fold stops there).
+        bool const moved = std::apply([&](auto&... o) { return (... || detail::leap(detail::seek(o, driver, cmp), o, driver, cmp)); }, others);
+        if (!moved) { return true; }
+      }
+      return false;
+    }
+
+    // The matching element of every range, in the order of the constructor.
+    std::tuple<DriverIterator, Iterators...> match() const
+    {
+      return std::apply([&](auto const&... o) { return std::tuple<DriverIterator, Iterators...>{driver.first, o.first...}; }, others);
+    }
+
+  private:
+    Comparator cmp;
+    detail::cursor<DriverIterator> driver;
+    std::tuple<detail::cursor<Iterators>...> others;
+    bool started{false};
+  };
+
+  template <typename Comparator, typename DriverIterator, typename... Iterators>
+  leapfrog(Comparator, std::pair<DriverIterator, DriverIterator>, std::pair<Iterators, Iterators>...) -> leapfrog<Comparator, DriverIterator, Iterators...>;
+
+
+  template <typename Comparator, typename Iterator>
+  class leapfrog_n
+  {
+  public:
+    leapfrog_n(Comparator cmp_, std::vector<std::pair<Iterator, Iterator>> const& ranges)
+      : cmp{cmp_}, order(ranges.size())
+    {
+      std::iota(order.begin(), order.end(), std::size_t{0});
+      std::sort(order.begin(), order.end(), [&](std::size_t x, std::size_t y)
+      {
+        return std::distance(ranges[x].first, ranges[x].second) < std::distance(ranges[y].first, ranges[y].second);
+      });
+      cursors.reserve(ranges.size());
+      for (auto k: order) { cursors.push_back({ranges[k].first, ranges[k].second}); }
+      rank.resize(ranges.size());
+      for (std::size_t r{0}; r < order.size(); ++r) { rank[order[r]] = r; }
+    }
+
+    bool next()
+    {
+      if (cursors.empty()) { return false; }
+      auto& driver = cursors.front();
+      if (started && (driver.first != driver.last)) { ++driver.first; }
+      started = true;
+
+      while (driver.first != driver.last)
+      {
+        bool moved{false};
+        for (std::size_t r{1}; (r < cursors.size()) && !moved; ++r)
+        {
+          moved = detail::leap(detail::seek(cursors[r], driver, cmp), cursors[r], driver, cmp);
+        }
+        if (!moved) { return true; }
+      }
+      return false;
+    }
+
+    // The matching element in range k (k as passed to the constructor).
+    Iterator match(std::size_t k) const { return cursors[rank[k]].first; }
+
+    Iterator match() const { return cursors.front().first; }
+
+  private:
+    Comparator cmp;
+    std::vector<std::size_t> order;   // order[r]: the range with the r-th smallest size
+    std::vector<std::size_t> rank;    // the inverse
+    std::vector<detail::cursor<Iterator>> cursors;   // by size
+    bool started{false};
+  };
+
+
+  // The out iterator version: comb gets the matching element of every range, in the order of the arguments.
+  template <typename OutIterator, typename Comparator, typename Combiner, typename DriverIterator, typename... Iterators>
+  OutIterator leapfrog_intersection(OutIterator out_it, Comparator cmp, Combiner&& comb,
+                                    std::pair<DriverIterator, DriverIterator> driver,
+                                    std::pair<Iterators, Iterators>... others)
+  {
+    leapfrog lf{cmp, driver, others...};
+    while (lf.next())
+    {
+      *out_it++ = std::apply([&](auto... its) { return comb(*its...); }, lf.match());
+    }
+    return out_it;
+  }
+}
+
+
+
+
+
+struct S
+{
+   explicit S(int id_, int v_) : id{id_}, v{v_} {}
+   int id;
+   int v;
+};
+
+
+struct M
+{
+   explicit M(int id_, int v_) : id{id_}, v{v_} {}
+   int id;
+   int v;
+};
+
+std::ostream& operator<<(std::ostream& os, S s) { return os << "S{" << s.id << ", " << s.v << "}"; }
+std::ostream& operator<<(std::ostream& os, M m) { return os << "M{" << m.id << ", " << m.v << "}"; }
+
+struct cmp
+{
+    bool operator()(S s, M m) { return s.id < m.id; }
+    bool operator()(M m, S s) { return m.id < s.id; }
+};
+
+
+int main()
+{
+    // Three sets, two types: the driver is S, and every comparison is between an S and an M.
+    std::vector<S> A{S{1,10}, S{2,20}, S{4,40}, S{7,70}};
+    std::vector<M> B{M{2,1}, M{4,2}, M{5,3}, M{7,4}};
+    std::vector<M> C{M{0,5}, M{2,6}, M{7,7}, M{9,8}};
+
+    my::leapfrog lf{cmp{}, std::pair{A.cbegin(), A.cend()}, std::pair{B.cbegin(), B.cend()}, std::pair{C.cbegin(), C.cend()}};
+    while (lf.next())
+    {
+        auto [a, b, c] = lf.match();
+        std::cout << *a << ' ' << *b << ' ' << *c << '\n';
+    }
+    // This prints: S{2, 20} M{2, 1} M{2, 6}
+    //              S{7, 70} M{7, 4} M{7, 7}
+
+    std::vector<int> sums;
+    my::leapfrog_intersection(std::back_inserter(sums), cmp{}, [](S s, M b, M c) { return s.v + b.v + c.v; },
+                              std::pair{A.cbegin(), A.cend()}, std::pair{B.cbegin(), B.cend()}, std::pair{C.cbegin(), C.cend()});
+    for (auto s: sums) { std::cout << s << ' '; }  // 27 81
+    std::cout << '\n';
+
+
+    // Posting lists: 12 lists from 5k to 4M document ids, the kind of query that intersects them all.
+    // (the ids are random in [0, 8M], plus 500 ids that every list has, so there is something to find)
+    std::mt19937 gen{17};
+    std::vector<int> common(500);
+    for (auto& x: common) { x = std::uniform_int_distribution<int>{0, 8'000'000}(gen); }
+    std::vector<std::vector<int>> lists;
+    for (std::size_t k{0}; k < 12; ++k)
+    {
+        std::size_t const size = (k % 2 == 0) ? 4'000'000 : 5'000 << (k / 2);
+        std::uniform_int_distribution<int> pick{0, 8'000'000};
+        std::vector<int> l(size);
+        for (auto& x: l) { x = pick(gen); }
+        l.insert(l.end(), common.begin(), common.end());
+        std::sort(l.begin(), l.end());
+        l.erase(std::unique(l.begin(), l.end()), l.end());
+        lists.push_back(std::move(l));
+    }
+
+    auto time = [](auto f)
+    {
+        auto start = std::chrono::steady_clock::now();
+        auto r = f();
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+        return std::pair{std::move(r), us};
+    };
+
+    // K - 1 passes, in the order of the query.
+    auto [pairwise, t_pairwise] = time([&]()
+    {
+        std::vector<int> acc = lists[0];
+        for (std::size_t k{1}; k < lists.size(); ++k)
+        {
+            std::vector<int> tmp;
+            std::set_intersection(acc.begin(), acc.end(), lists[k].begin(), lists[k].end(), std::back_inserter(tmp));
+            acc = std::move(tmp);
+        }
+        return acc;
+    });
+
+    auto [leap, t_leap] = time([&]()
+    {
+        std::vector<std::pair<std::vector<int>::const_iterator, std::vector<int>::const_iterator>> ranges;
+        for (auto const& l: lists) { ranges.emplace_back(l.cbegin(), l.cend()); }
+        my::leapfrog_n lfn{std::less<>{}, ranges};
+        std::vector<int> out;
+        while (lfn.next()) { out.push_back(*lfn.match()); }
+        return out;
+    });
+
+    std::cout << "pairwise: " << pairwise.size() << " matches in " << t_pairwise << "us\n";
+    std::cout << "leapfrog: " << leap.size() << " matches in " << t_leap << "us" << (leap == pairwise ? "" : " (DIFFERENT)") << '\n';
+}
@@ -0,0 +1,368 @@
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <vector>
+#include <iterator>
+#include <type_traits>
+#include <thread>
+#include <chrono>
+#include <random>
+
+// my::set_intersection and my::join (set_intersection.cpp) are one loop on one thread.
+// To split the work, cut both sorted inputs into chunks that can be processed independently:
+// chunk k is [a_k, a_k+1) x [b_k, b_k+1), and every key of chunk k is less than every key of chunk k+1.
+//
+// Where to cut: merge path. The merge of A and B is a path of n1 + n2 steps; the point at step d splits A at
+// i and B at d - i (the co-rank), found with a binary search on the diagonal. Cutting at evenly spaced
+// diagonals gives chunks with the same amount of work, whatever the distribution of the keys.
+//
+// A cut may fall inside a run of equal keys, and my::join must see the whole run on both sides (it emits
+// every pair). So a cut inside a run whose key is in both inputs is moved back to the start of that run, on
+// both sides. Then:
+//   - the chunks are independent: each thread runs the sequential algorithm on its chunk, into its own buffer,
+//   - the output of chunk k comes before the output of chunk k+1, so the result is the concatenation of the
+//     buffers: sizes are summed, the result is allocated once, and each thread moves its buffer in place.
+// No lock anywhere.
+// (A single huge run of one key can't be split, so it lands in one chunk.)
+
+namespace my
+{
+
+  template <typename Iterator1, typename Iterator2, typename OutIterator, typename Comparator,
+            typename Combiner
+            >
+  OutIterator set_intersection(Iterator1 first1, Iterator1 last1,
+                               Iterator2 first2, Iterator2 last2,
+                               OutIterator out_it,
+                               Comparator cmp,
+                               Combiner&& comb)
+  {
+
+    for ( ; (first1 != last1) && (first2 != last2) ; )
+    {
+         if      (cmp(*first1, *first2)) { first1++; }
+         else if (cmp(*first2, *first1)) { first2++; }
+         else                            { *out_it++ = comb(*first1++, *first2++); }
+    }
+    return out_it;
+  }
+
+
+
+  template <typename Iterator1, typename Iterator2, typename OutIterator, typename Comparator,
+            typename Combiner
+            >
+  OutIterator join(Iterator1 first1, Iterator1 last1,
+                               Iterator2 first2, Iterator2 last2,
+                               OutIterator out_it,
+                               Comparator cmp,
+                               Combiner&& comb)
+  {
+
+    for (auto fixed_f2=first2 ; (first1 != last1) && (fixed_f2 != last2) ; )
+    {
+         if      ((first2 == last2) || cmp(*first1, *first2)) { first1++; first2 = fixed_f2;}
+         else if (cmp(*first2, *first1)) { first2++; fixed_f2 = first2; }
+         else                            { *out_it++ = comb(*first1, *first2++); }
+    }
+    return out_it;
+  }
+
+
+  namespace detail
+  {
+    // The comparator is heterogeneous: cmp(A, B) and cmp(B, A) exist, cmp(A, A) may not.
+    // So A is only ever searched with a key of B, and B with a key of A.
+    template <typename Iterator, typename T, typename Comparator>
+    Iterator lower_bound(Iterator first, Iterator last, T const& value, Comparator& cmp)
+    {
+      return std::lower_bound(first, last, value, [&](auto const& e, auto const& v) { return cmp(e, v); });
+    }
+
+    // Merge path: how many elements of A are in the first d elements of the merge (A first on ties).
+    template <typename Iterator1, typename Iterator2, typename Comparator>
+    std::size_t co_rank(std::size_t d, Iterator1 a, std::size_t n1, Iterator2 b, std::size_t n2, Comparator& cmp)
+    {
+      std::size_t lo = (d > n2) ? d - n2 : 0;
+      std::size_t hi = std::min(d, n1);
+      while (lo < hi)
+      {
+        std::size_t const i = lo + (hi - lo) / 2;
+        std::size_t const j = d - i;             // i < hi, so j >= 1 and b[j - 1] exists.
+        if (!cmp(b[j - 1], a[i])) { lo = i + 1; } // a[i] <= b[j - 1]: a[i] is in the first d, i is too small.
+        else                      { hi = i; }
+      }
+      return lo;
+    }
+
+    struct cut
+    {
+      std::size_t i;
+      std::size_t j;
+    };
+
+    // (i, j) is a point of the merge path: everything before it comes before everything after it in the merge.
+    // The key at the cut is the next one of the merge, min(a[i], b[j]). Its run may start before the cut, on
+    // one side or both: if it does on both, the cut moves back to the start of the run; if the key has elements
+    // in one input only, cutting its run is harmless (there is nothing to pair it with). The cut stays at the
+    // diagonal otherwise, so the chunks keep the same size whatever the sizes of A and B.
+    template <typename Iterator1, typename Iterator2, typename Comparator>
+    cut snap(cut c, Iterator1 a, std::size_t n1, Iterator2 b, std::size_t n2, Comparator& cmp)
+    {
+      auto [i, j] = c;
+      if ((i < n1) && ((j == n2) || !cmp(b[j], a[i])))
+      {
+        // the key is a[i] (A first on ties): b[j - 1] < a[i], so the run can only start earlier in A, and only
+        // matters if b[j] has the key too.
+        if ((j < n2) && !cmp(a[i], b[j])) { i = detail::lower_bound(a, a + i, b[j], cmp) - a; }
+      }
+      else if (j < n2)
+      {
+        // the key is b[j] < a[i]: the run starts earlier in both only if a[i - 1] has the key.
+        if ((i > 0) && !cmp(a[i - 1], b[j]))
+        {
+          std::size_t const i0 = detail::lower_bound(a, a + i, b[j], cmp) - a;
+          j = detail::lower_bound(b, b + j, a[i - 1], cmp) - b;
+          i = i0;
+        }
+      }
+      return {i, j};
+    }
+
+    template <typename Iterator1, typename Iterator2, typename Comparator>
+    std::vector<cut> partition(Iterator1 a, std::size_t n1, Iterator2 b, std::size_t n2, std::size_t chunks, Comparator& cmp)
+    {
+      std::vector<cut> cuts;
+      cuts.reserve(chunks + 1);
+      cuts.push_back({0, 0});
+      for (std::size_t k{1}; k < chunks; ++k)
+      {
+        std::size_t const d = (n1 + n2) * k / chunks;
+        std::size_t const i = co_rank(d, a, n1, b, n2, cmp);
+        cut c = snap(cut{i, d - i}, a, n1, b, n2, cmp);
+        // two diagonals inside the same run snap to the same cut: that's just an empty chunk.
+        c.i = std::max(c.i, cuts.back().i);
+        c.j = std::max(c.j, cuts.back().j);
+        cuts.push_back(c);
+      }
+      cuts.push_back({n1, n2});
+      return cuts;
+    }
+
+    // The driver for both algorithms: algo is the sequential algorithm, run on every chunk.
+    template <typename Iterator1, typename Iterator2, typename Comparator, typename Combiner, typename Algo>
+    auto parallel_run(Iterator1 first1, Iterator1 last1,
+                      Iterator2 first2, Iterator2 last2,
+                      Comparator cmp,
+                      Combiner& comb,
+                      std::size_t threads,
+                      Algo algo)
+    {
+      using result_t = std::decay_t<decltype(comb(*first1, *first2))>;
+
+      auto const n1 = static_cast<std::size_t>(last1 - first1);
+      auto const n2 = static_cast<std::size_t>(last2 - first2);
+      if (threads == 0) { threads = std::max(1u, std::thread::hardware_concurrency()); }
+
+      auto const cuts = partition(first1, n1, first2, n2, threads, cmp);
+      std::vector<std::vector<result_t>> buffers(threads);
+      std::vector<result_t> result;
+      std::vector<std::size_t> offsets(threads + 1, 0);
+
+      auto in_parallel = [&](auto task)
+      {
+        std::vector<std::thread> workers;
+        workers.reserve(threads - 1);
+        for (std::size_t k{1}; k < threads; ++k) { workers.emplace_back(task, k); }
+        task(0);
+        for (auto& w: workers) { w.join(); }
+      };
+
+      // 1. every chunk into its own buffer.
+      in_parallel([&](std::size_t k)
+      {
+        algo(first1 + cuts[k].i, first1 + cuts[k + 1].i,
+             first2 + cuts[k].j, first2 + cuts[k + 1].j,
+             std::back_inserter(buffers[k]), cmp, comb);
+      });
+
+      // 2. where each buffer goes in the result.
+      for (std::size_t k{0}; k < threads; ++k) { offsets[k + 1] = offsets[k] + buffers[k].size(); }
+      result.resize(offsets[threads]);
+
+      // 3. every buffer moved to its place.
+      in_parallel([&](std::size_t k)
+      {
+        std::move(buffers[k].begin(), buffers[k].end(), result.begin() + offsets[k]);
+        std::vector<result_t>{}.swap(buffers[k]);
+      });
+      return result;
+    }
+  }
+
+
+  // Same output as my::set_intersection into a std::vector (the result type of comb must be default
+  // constructible). threads == 0 means one per core.
+  template <typename Iterator1, typename Iterator2, typename Comparator, typename Combiner>
+  auto parallel_set_intersection(Iterator1 first1, Iterator1 last1,
+                                 Iterator2 first2, Iterator2 last2,
+                                 Comparator cmp,
+                                 Combiner&& comb,
+                                 std::size_t threads = 0)
+  {
+    return detail::parallel_run(first1, last1, first2, last2, cmp, comb, threads,
+                                [](auto... args) { return my::set_intersection(args...); });
+  }
+
+  // Same output as my::join, in the same order.
+  template <typename Iterator1, typename Iterator2, typename Comparator, typename Combiner>
+  auto parallel_join(Iterator1 first1, Iterator1 last1,
+                     Iterator2 first2, Iterator2 last2,
+                     Comparator cmp,
+                     Combiner&& comb,
+                     std::size_t threads = 0)
+  {
+    return detail::parallel_run(first1, last1, first2, last2, cmp, comb, threads,
+                                [](auto... args) { return my::join(args...); });
+  }
+}
+
+
+
+
+
+struct S
+{
+   explicit S(int id_, int v_) : id{id_}, v{v_} {}
+   int id;
+   int v;
+};
+
+
+struct M
+{
+   explicit M(int id_, int v_) : id{id_}, v{v_} {}
+   int id;
+   int v;
+};
+
+std::ostream& operator<<(std::ostream& os, S s) { return os << "S{" << s.id << ", " << s.v << "}"; }
+std::ostream& operator<<(std::ostream& os, M m) { return os << "M{" << m.id << ", " << m.v << "}"; }
+
+struct cmp
+{
+    bool operator()(S s, M m) { return s.id < m.id; }
+    bool operator()(M m, S s) { return m.id < s.id; }
+};
+
+
+int main()
+{
+    // The example of set_intersection.cpp, cut in 4 chunks (most of them empty): the same output.
+    std::vector<M> A{M{2,2},M{2,3}, M{5,5}};
+    std::vector<S> B{S{2,1},S{2,4}};
+
+    auto comb = [](M m, S s)
+    {
+        std::ostringstream os;
+        os <<  m << "-" << s;
+        return os.str();
+    };
+
+    auto C = my::parallel_join(std::cbegin(A), std::cend(A), std::cbegin(B), std::cend(B), cmp{}, comb, 4);
+    std::cout << "C: ";  for (auto c: C) { std::cout << c << ' '; } std::cout << '\n';
+    // This prints: C: M{2, 2}-S{2, 1} M{2, 2}-S{2, 4} M{2, 3}-S{2, 1} M{2, 3}-S{2, 4}
+
+
+    // Skewed inputs: the cuts follow the diagonals, so the chunks stay even whatever the sizes of A and B.
+    {
+        auto chunks = [](auto const& a, auto const& b)
+        {
+            cmp c;
+            auto const cuts = my::detail::partition(a.cbegin(), a.size(), b.cbegin(), b.size(), 4, c);
+            for (std::size_t k{0}; k + 1 < cuts.size(); ++k)
+            {
+                std::cout << '[' << cuts[k + 1].i - cuts[k].i << '+' << cuts[k + 1].j - cuts[k].j << ']';
+            }
+            std::cout << '\n';
+        };
+
+        std::vector<M> two{M{0, 0}, M{1'000'000, 1}};
+        std::vector<S> dense;
+        for (int id{1}; id < 1'000'000; ++id) { dense.emplace_back(id, id); }
+        chunks(two, dense);     // [1+249999][0+250000][0+250000][1+250000]
+
+        std::vector<M> few;
+        for (int id{0}; id < 1'000; ++id) { few.emplace_back(id * 1'000, id); }
+        std::vector<S> many;
+        for (int id{0}; id < 1'000'000; ++id) { many.emplace_back(id, id); }
+        chunks(few, many);      // [250+250000][250+250000][250+250000][250+250000]
+    }
+
+
+    // Long runs of duplicate keys, so plenty of cuts fall inside a run.
+    std::mt19937 gen{3};
+    auto make = [&](auto tag, std::size_t n, int max_id)
+    {
+        using T = typename decltype(tag)::type;
+        std::uniform_int_distribution<int> pick{0, max_id};
+        std::vector<int> ids(n);
+        for (auto& id: ids) { id = pick(gen); }
+        std::sort(ids.begin(), ids.end());
+        std::vector<T> v;
+        v.reserve(n);
+        for (std::size_t i{0}; i < n; ++i) { v.emplace_back(ids[i], static_cast<int>(i)); }
+        return v;
+    };
+    struct m_tag { using type = M; };
+    struct s_tag { using type = S; };
+
+    auto pair_comb = [](M const& m, S const& s) { return std::pair{m.v, s.v}; };
+
+    for (int max_id: {10, 1000, 100'000})
+    {
+        auto big_m = make(m_tag{}, 200'000, max_id);
+        auto big_s = make(s_tag{}, 150'000, max_id);
+        if (max_id == 10) { big_s.erase(big_s.begin() + 2'000, big_s.end()); }  // else billions of pairs
+
+        std::vector<std::pair<int, int>> expected;
+        my::join(big_m.cbegin(), big_m.cend(), big_s.cbegin(), big_s.cend(), std::back_inserter(expected), cmp{}, pair_comb);
+        auto got = my::parallel_join(big_m.cbegin(), big_m.cend(), big_s.cbegin(), big_s.cend(), cmp{}, pair_comb, 7);
+
+        std::vector<std::pair<int, int>> expected_si;
+        my::set_intersection(big_m.cbegin(), big_m.cend(), big_s.cbegin(), big_s.cend(), std::back_inserter(expected_si), cmp{}, pair_comb);
+        auto got_si = my::parallel_set_intersection(big_m.cbegin(), big_m.cend(), big_s.cbegin(), big_s.cend(), cmp{}, pair_comb, 7);
+
+        std::cout << "keys in [0, " << max_id << "]: join " << (got == expected ? "same" : "DIFFERENT")
+                  << " (" << got.size() << " pairs), set_intersection " << (got_si == expected_si ? "same" : "DIFFERENT") << '\n';
+    }
+
+
+    // The benchmark: two sorted inputs of 20M rows.
+    auto huge_m = make(m_tag{}, 20'000'000, 40'000'000);
+    auto huge_s = make(s_tag{}, 20'000'000, 40'000'000);
+    auto count_comb = [](M const& m, S const& s) { return m.v + s.v; };
+
+    auto time = [](auto f)
+    {
+        auto start = std::chrono::steady_clock::now();
+        auto n = f();
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+        return std::pair{n, us};
+    };
+
+    auto [n1, t1] = time([&]()
+    {
+        std::vector<int> out;
+        my::join(huge_m.cbegin(), huge_m.cend(), huge_s.cbegin(), huge_s.cend(), std::back_inserter(out), cmp{}, count_comb);
+        return out.size();
+    });
+    std::cout << "join, 1 thread:    " << n1 << " pairs in " << t1 << "us\n";
+
+    unsigned const cores = std::max(1u, std::thread::hardware_concurrency());
+    auto [n2, t2] = time([&]()
+    {
+        return my::parallel_join(huge_m.cbegin(), huge_m.cend(), huge_s.cbegin(), huge_s.cend(), cmp{}, count_comb).size();
+    });
+    std::cout << "join, " << cores << " threads:   " << n2 << " pairs in " << t2 << "us\n";
+}
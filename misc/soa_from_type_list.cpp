@@ -0,0 +1,217 @@
+#include <iostream>
+#include <type_traits>
+#include <utility>
+#include <tuple>
+#include <vector>
+
+// sub_list_t projects a type list on a tuple of chosen indices (see sublists_and_index_sequences.cpp).
+// Here we use it for a data layout: a struct of arrays (SoA), one contiguous vector per field,
+// and views that only touch the selected columns.
+// If a scan needs 2 fields out of 20, it only streams those 2 arrays through the cache.
+
+template <typename... Args>
+struct types_list {};
+
+
+namespace detail
+{
+    template <std::size_t n, typename... Args>
+    struct get_type;
+
+    template <typename T, typename... Others>
+    struct get_type<0, T, Others...>
+    {
+        using type = T;
+    };
+
+    template <std::size_t n, typename T, typename... Others>
+    struct get_type<n, T, Others...>
+    {
+        using type = typename get_type<n-1, Others...>::type;
+    };
+}
+
+
+namespace detail
+{
+
+  constexpr std::size_t get_number(std::size_t n) { return n; }
+
+  template <typename T>
+  constexpr std::size_t get_number(T n) { return static_cast<std::size_t>(n); }
+}
+
+
+template <auto n, typename... Args>
+struct get_type_base
+{
+   static constexpr std::size_t sn = detail::get_number(n);
+   using type = typename detail::get_type<sn, Args...>::type;
+};
+
+template <auto  n, typename... Args>
+struct get_type : get_type_base<n, Args...>
+{
+};
+
+template <auto n, template <typename...> typename TypeContainer, typename... Args>
+struct get_type<n, TypeContainer<Args...>> : get_type_base<n, Args...> {};
+
+template <auto n, typename... Args>
+using get_type_t = typename get_type<n, Args...>::type;
+
+
+template <typename TypeList, std::size_t... Ns>
+struct raw_sub_list
+{
+ using type = std::tuple<typename get_type<Ns, TypeList>::type...>;
+};
+
+template <typename TypeList, typename Indices>
+struct sub_list;
+
+template <typename TypeList, std::size_t... Ns>
+struct sub_list<TypeList, std::index_sequence<Ns...>> : raw_sub_list<TypeList, Ns...>
+{
+};
+
+template <typename TypeList, typename Indices>
+using sub_list_t = typename sub_list<TypeList, Indices>::type;
+
+
+// Turns a tuple of types into a tuple of (const) references to these types.
+// This is the row type a view hands out.
+template <typename Tuple, bool is_const>
+struct ref_tuple;
+
+template <typename... Ts, bool is_const>
+struct ref_tuple<std::tuple<Ts...>, is_const>
+{
+    using type = std::tuple<std::conditional_t<is_const, Ts const&, Ts&>...>;
+};
+
+template <typename Tuple, bool is_const>
+using ref_tuple_t = typename ref_tuple<Tuple, is_const>::type;
+
+
+template <typename FieldList>
+class soa;
+
+template <typename Soa, typename Indices, bool is_const>
+class soa_view;
+
+
+template <typename... Fs>
+class soa<types_list<Fs...>>
+{
+public:
+    using field_list = types_list<Fs...>;
+
+    void push_back(Fs... fs)
+    {
+        push_back_impl(std::index_sequence_for<Fs...>{}, std::move(fs)...);
+    }
+
+    void reserve(std::size_t n) { std::apply([n](auto&... c) { (c.reserve(n), ...); }, columns); }
+
+    std::size_t size() const { return std::get<0>(columns).size(); }
+
+    template <std::size_t I>
+    std::vector<get_type_t<I, field_list>>& column() { return std::get<I>(columns); }
+
+    template <std::size_t I>
+    std::vector<get_type_t<I, field_list>> const& column() const { return std::get<I>(columns); }
+
+    // A view over the columns Ns... only. The row type is sub_list_t<field_list, ...> as references.
+    template <std::size_t... Ns>
+    soa_view<soa, std::index_sequence<Ns...>, false> view() { return {*this}; }
+
+    template <std::size_t... Ns>
+    soa_view<soa, std::index_sequence<Ns...>, true> view() const { return {*this}; }
+
+private:
+    template <std::size_t... Is>
+    void push_back_impl(std::index_sequence<Is...>, Fs&&... fs)
+    {
+        (std::get<Is>(columns).push_back(std::move(fs)), ...);
+    }
+
+    std::tuple<std::vector<Fs>...> columns;
+};
+
+
+template <typename Soa, std::size_t... Ns, bool is_const>
+class soa_view<Soa, std::index_sequence<Ns...>, is_const>
+{
+public:
+    using soa_type   = std::conditional_t<is_const, Soa const, Soa>;
+    using value_type = sub_list_t<typename Soa::field_list, std::index_sequence<Ns...>>;
+    using reference  = ref_tuple_t<value_type, is_const>;
+
+    soa_view(soa_type& s) : data{s.template column<Ns>().data()...}, n{s.size()} {}
+
+    // The iterator is just a row number; dereferencing reads the selected columns at that row.
+    class iterator
+    {
+    public:
+        iterator(soa_view const* v_, std::size_t i_) : v{v_}, i{i_} {}
+
+        reference operator*() const { return (*v)[i]; }
+        iterator& operator++() { ++i; return *this; }
+        bool operator!=(iterator const& o) const { return i != o.i; }
+        bool operator==(iterator const& o) const { return i == o.i; }
+
+    private:
+        soa_view const* v;
+        std::size_t i;
+    };
+
+    iterator begin() const { return {this, 0}; }
+    iterator end()   const { return {this, n}; }
+    std::size_t size() const { return n; }
+
+    reference operator[](std::size_t i) const { return row(i, std::make_index_sequence<sizeof...(Ns)>{}); }
+
+private:
+    // The pointers are stored in the order of Ns..., so we walk them by position.
+    template <std::size_t... Ps>
+    reference row(std::size_t i, std::index_sequence<Ps...>) const { return {std::get<Ps>(data)[i]...}; }
+
+    template <std::size_t I>
+    using column_ptr = std::conditional_t<is_const, get_type_t<I, typename Soa::field_list> const*,
+                                                    get_type_t<I, typename Soa::field_list>*>;
+
+    std::tuple<column_ptr<Ns>...> data;
+    std::size_t n;
+};
+
+
+int main()
+{
+    enum Field { Id = 0, Price, Qty, Side, Venue };
+    using order_fields = types_list<int, double, int, char, short>;
+
+    soa<order_fields> orders;
+    orders.reserve(4);
+    orders.push_back(1, 10.5, 100, 'B', 3);
+    orders.push_back(2, 10.7,  50, 'S', 1);
+    orders.push_back(3, 10.6, 200, 'B', 3);
+    orders.push_back(4, 10.4,  10, 'S', 2);
+
+    // The row type of a view is the sub list of the selected fields.
+    static_assert(std::is_same_v<decltype(orders.view<Price, Qty>())::value_type, std::tuple<double, int>>);
+
+    // notional: only the Price and Qty arrays are read.
+    double notional{0};
+    for (auto [price, qty]: orders.view<Price, Qty>()) { notional += price * qty; }
+    std::cout << "notional: " << notional << '\n'; // notional: 3809
+
+    // views are writable.
+    for (auto [qty, side]: orders.view<Qty, Side>()) { if (side == 'S') { qty = -qty; } }
+    for (auto q: orders.column<Qty>()) { std::cout << q << ' '; } std::cout << '\n'; // 100 -50 200 -10
+
+    // and columns can be picked in any order.
+    auto const& corders = orders;
+    auto v = corders.view<Venue, Id>();
+    std::cout << std::get<0>(v[2]) << ' ' << std::get<1>(v[2]) << '\n'; // 3 3
+}
@@ -0,0 +1,163 @@
+#include <iostream>
+#include <utility>
+#include <type_traits>
+#include <array>
+#include <vector>
+#include <numeric>
+#include <tuple>
+
+// for_each_n<n>(f) (see comma_operator_application_repeat_n.cpp) calls f n times, but f never knows
+// *which* call it is, it cannot stop early and it only works when n is known at compile time.
+//
+// Here we grow it into two tools:
+//   1. static_for<N>(f)          : f(std::integral_constant<std::size_t, I>{}) for I in [0, N).
+//   2. unrolled_for<Unroll>(n, f) : a runtime loop over [0, n), the body is stamped Unroll times per
+//                                   iteration, the leftover (n % Unroll) is handled by a remainder loop.
+//
+// In both cases, if f returns bool, returning false means "break".
+
+namespace detail
+{
+
+// Why integral_constant and not a plain std::size_t? because the body can then use I as a
+// constant expression (std::get<I>, template arguments, array sizes ...).
+template <std::size_t I>
+using index_c = std::integral_constant<std::size_t, I>;
+
+template <typename F, std::size_t I>
+constexpr bool returns_bool_v = std::is_same_v<std::invoke_result_t<F&, index_c<I>>, bool>;
+
+// Call f(index_c<I>) and translate the result to "should I continue?".
+// A void body never breaks.
+template <std::size_t I, typename F>
+constexpr bool invoke_indexed(F& f)
+{
+    if constexpr (returns_bool_v<F, I>)
+    {
+        return f(index_c<I>{});
+    }
+    else
+    {
+        f(index_c<I>{});
+        return true;
+    }
+}
+
+template <typename IndexSeq>
+struct static_for;
+
+template <std::size_t... I>
+struct static_for<std::index_sequence<I...>>
+{
+   // The fold over && short circuits, so this is the early exit.
+   // It also removes the comma operator warning we had in for_each_n.
+   // Returns true if all the iterations ran.
+   template <typename F>
+   constexpr bool operator()(F& f)
+   {
+      return (invoke_indexed<I>(f) && ...);
+   }
+};
+
+}
+
+
+template <std::size_t N, typename F>
+constexpr bool static_for(F&& f)
+{
+    return detail::static_for<std::make_index_sequence<N>>{}(f);
+}
+
+
+namespace detail
+{
+
+// The body of unrolled_for gets a runtime index (i), so we adapt it to a static_for body.
+// When the user body breaks, we remember where, so unrolled_for can report it.
+template <typename F>
+struct unrolled_body
+{
+    template <std::size_t J>
+    constexpr bool operator()(index_c<J>)
+    {
+        if constexpr (std::is_same_v<std::invoke_result_t<F&, std::size_t>, bool>)
+        {
+            if (f(base + J)) { return true; }
+            stop = base + J;
+            return false;
+        }
+        else
+        {
+            f(base + J);
+            return true;
+        }
+    }
+
+    F& f;
+    std::size_t base;
+    std::size_t stop;
+};
+
+}
+
+// Returns the number of iterations that ran completely (i.e. n, unless the body broke early;
+// in that case, it is the index where it broke).
+template <std::size_t Unroll, typename F>
+std::size_t unrolled_for(std::size_t n, F&& f)
+{
+    static_assert(Unroll > 0, "Unroll must be at least 1");
+
+    std::size_t i{0};
+
+    // The unrolled part: Unroll copies of the body per trip, no loop counter checks in between.
+    for (std::size_t const main_n = n - n % Unroll; i < main_n; i += Unroll)
+    {
+        detail::unrolled_body<F> body{f, i, n};
+        if (!detail::static_for<std::make_index_sequence<Unroll>>{}(body)) { return body.stop; }
+    }
+
+    // The remainder (at most Unroll-1 iterations).
+    for ( ; i < n; ++i)
+    {
+        detail::unrolled_body<F> lane{f, i, n};
+        if (!lane(detail::index_c<0>{})) { return lane.stop; }
+    }
+    return n;
+}
+
+
+int main()
+{
+    // static_for with the index injected.
+    static_for<4>([](auto i) { std::cout << "f" << i << ' '; });
+    std::cout << '\n';
+
+    // since i is an integral_constant, it can be used as a template argument.
+    std::tuple<int, char, double> t{1, 'a', 2.5};
+    static_for<3>([&](auto i) { std::cout << std::get<i>(t) << ' '; });
+    std::cout << '\n';
+
+    // early exit: stop after the third call.
+    bool completed = static_for<10>([](auto i) { std::cout << i; return i < 2; });
+    std::cout << " completed: " << completed << '\n'; // prints 012 completed: 0
+
+    // static_for is constexpr.
+    constexpr auto sum = []() { std::size_t s{0}; static_for<5>([&](auto i) { s += i; }); return s; }();
+    static_assert(sum == 10);
+
+    // unrolled_for: a runtime trip count (11) split into 2 blocks of 4 + a remainder of 3.
+    std::vector<int> v(11);
+    std::iota(v.begin(), v.end(), 1);
+    int acc{0};
+    auto ran = unrolled_for<4>(v.size(), [&](std::size_t i) { acc += v[i]; });
+    std::cout << "sum: " << acc << " ran: " << ran << '\n'; // sum: 66 ran: 11
+
+    // unrolled_for with an early exit: find the first element greater than 6.
+    auto pos = unrolled_for<4>(v.size(), [&](std::size_t i) { return v[i] <= 6; });
+    std::cout << "first > 6 at: " << pos << '\n'; // first > 6 at: 6
+
+    // Breaking in the middle of a block: the lanes after the break are not called.
+    std::array<int, 9> calls{};
+    unrolled_for<4>(calls.size(), [&](std::size_t i) { calls[i]++; return i != 5; });
+    for (auto c: calls) { std::cout << c; } std::cout << '\n'; // 111111000
+}
@@ -0,0 +1,525 @@
+#include <iostream>
+#include <utility>
+#include <type_traits>
+#include <tuple>
+#include <array>
+#include <vector>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <stdexcept>
+#include <chrono>
+#include <numeric>
+
+// guaranteeing_dependency_in_pipeline_1.cpp builds every stage once, and that's it: nothing flows.
+// Here the data moves through the depends_on DAG in batches:
+//   - every stage runs on its own thread,
+//   - every edge of the DAG is a bounded lock free single producer / single consumer queue,
+//   - a full queue blocks the producer (back pressure), so a fast stage cannot run away with the memory.
+// While C1 works on batch k, B1 and B2 work on batch k+1 and A1 produces batch k+2:
+// the throughput is set by the slowest stage, not by the sum of all of them.
+//
+// A stage with several dependents gets one queue per dependent (the batch itself is shared, not copied),
+// and a stage with several inputs reads one queue per input. So we never need an MPSC queue, and every
+// queue keeps the cheap SPSC protocol.
+
+template <typename... Args>
+struct types_list {};
+
+
+namespace detail
+{
+
+template <typename T, typename TypeList>
+struct type_exists;
+
+template <typename T, typename... Args>
+struct type_exists<T, types_list<Args...>> : std::bool_constant<(std::is_same_v<T, Args> || ...)> {};
+
+template <typename T, typename TypeList>
+constexpr bool type_exists_v = type_exists<T, TypeList>::value;
+
+
+template <typename T, typename TypeList>
+struct append;
+
+template <typename T, typename... Args>
+struct append<T, types_list<Args...>>
+{
+    using type = types_list<Args..., T>;
+};
+
+
+template <typename T, typename Path, typename Done, bool already_done = type_exists_v<T, Done>>
+struct visit;
+
+template <typename Deps, typename Path, typename Done>
+struct visit_all;
+
+template <typename T, typename Path, typename Done>
+struct visit<T, Path, Done, true>
+{
+    using type = Done;
+};
+
+template <typename T, typename... Path, typename Done>
+struct visit<T, types_list<Path...>, Done, false>
+{
+    static constexpr bool is_cycle = type_exists_v<T, types_list<Path...>>;
+    static_assert(!is_cycle, "depends_on has a cycle");
+
+    using deps = std::conditional_t<is_cycle, std::tuple<>, typename T::depends_on>;
+    using deps_done = typename visit_all<deps, types_list<Path..., T>, Done>::type;
+    using type = typename append<T, deps_done>::type;
+};
+
+template <typename Path, typename Done>
+struct visit_all<std::tuple<>, Path, Done>
+{
+    using type = Done;
+};
+
+template <typename D, typename... Ds, typename Path, typename Done>
+struct visit_all<std::tuple<D, Ds...>, Path, Done>
+{
+    using type = typename visit_all<std::tuple<Ds...>, Path, typename visit<D, Path, Done>::type>::type;
+};
+
+}
+
+template <typename... Ts>
+using topological_order_t = typename detail::visit_all<std::tuple<Ts...>, types_list<>, types_list<>>::type;
+
+
+namespace detail
+{
+    template <typename Deps, typename... Ts>
+    struct depends_row;
+
+    template <typename... Ds, typename... Ts>
+    struct depends_row<std::tuple<Ds...>, Ts...>
+    {
+        static constexpr std::array<bool, sizeof...(Ts)> value{type_exists_v<Ts, types_list<Ds...>>...};
+    };
+
+    // depends[i][j]: stage j is in the depends_on of stage i.
+    template <typename... Ts>
+    constexpr std::array<std::array<bool, sizeof...(Ts)>, sizeof...(Ts)> depends_matrix()
+    {
+        return {depends_row<typename Ts::depends_on, Ts...>::value...};
+    }
+
+    template <typename T, typename... Ts>
+    struct index_of : std::integral_constant<std::size_t, 0> {};
+
+    template <typename T, typename F, typename... Ts>
+    struct index_of<T, F, Ts...>
+        : std::integral_constant<std::size_t, std::is_same_v<T, F> ? 0 : 1 + index_of<T, Ts...>::value> {};
+}
+
+
+// ------------------------------------------------------------------------------------------------
+// A bounded SPSC ring buffer.
+// head is only written by the consumer, tail only by the producer; each lives on its own cache line,
+// so the two threads don't fight over the same line on every operation.
+// push on a full queue / pop on an empty one spin a little (the other side is usually right there), then
+// sleep on a condition variable. The other side only takes the mutex to wake it when somebody sleeps.
+// ------------------------------------------------------------------------------------------------
+
+template <typename T, std::size_t Capacity>
+class spsc_queue
+{
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    bool try_push(T& v) { return put(v) && (wake(), true); }
+    bool try_pop(T& v) { return take(v) && (wake(), true); }
+
+    // The blocking versions. Waiting in push is the back pressure.
+    void push(T v) { wait_for([&]() { return put(v); }); wake(); }
+    T pop() { T v; wait_for([&]() { return take(v); }); wake(); return v; }
+
+private:
+    static constexpr int spins = 64;
+
+    bool put(T& v)
+    {
+        std::size_t const tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) == Capacity) { return false; }
+        slots[tail & (Capacity - 1)] = std::move(v);
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool take(T& v)
+    {
+        std::size_t const head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire)) { return false; }
+        v = std::move(slots[head & (Capacity - 1)]);
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    template <typename Try>
+    void wait_for(Try attempt)
+    {
+        for (int i{0}; i < spins; ++i)
+        {
+            if (attempt()) { return; }
+            std::this_thread::yield();
+        }
+
+        std::unique_lock<std::mutex> lock{mutex};
+        sleepers.fetch_add(1);
+        // with the fence in wake(): either we see the other side's update, or it sees us asleep.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        cv.wait(lock, attempt);
+        sleepers.fetch_sub(1);
+    }
+
+    void wake()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleepers.load(std::memory_order_relaxed) > 0)
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            cv.notify_all();
+        }
+    }
+
+    alignas(64) std::atomic<std::size_t> head_{0};
+    alignas(64) std::atomic<std::size_t> tail_{0};
+    alignas(64) std::atomic<int> sleepers{0};
+    std::mutex mutex;
+    std::condition_variable cv;
+    alignas(64) std::array<T, Capacity> slots{};
+};
+
+
+// ------------------------------------------------------------------------------------------------
+// The streaming executor.
+//
+// A source stage (empty depends_on) has:   std::optional<output> produce();   (nullopt ends the stream)
+// Any other stage has:                     output process(Dep1::output const&, Dep2::output const&, ...);
+// A sink (nobody depends on it) may return void from process.
+// ------------------------------------------------------------------------------------------------
+
+template <typename TypeList, std::size_t QueueCapacity = 8>
+class streaming_pipeline;
+
+template <typename... Ts, std::size_t QueueCapacity>
+class streaming_pipeline<types_list<Ts...>, QueueCapacity>
+{
+public:
+    static constexpr std::size_t N = sizeof...(Ts);
+    static constexpr auto depends = detail::depends_matrix<Ts...>();
+
+    template <typename T>
+    static constexpr std::size_t index_v = detail::index_of<T, Ts...>::value;
+
+    // A batch travels as a shared_ptr to const: every dependent reads the same batch, and nullptr
+    // is the end of the stream.
+    template <typename T>
+    using message_t = std::shared_ptr<typename T::output const>;
+
+    template <typename T>
+    using queue_t = spsc_queue<message_t<T>, QueueCapacity>;
+
+    streaming_pipeline()
+    {
+        make_queues(std::index_sequence_for<Ts...>{});
+    }
+
+    template <typename T>
+    T& get() { return std::get<T>(stages); }
+
+    // Runs until every source is exhausted and every batch went through.
+    // If a stage throws, the sources stop, every stage drains its inputs and ends its outputs, and the first
+    // exception is rethrown here once all the threads are joined.
+    void run()
+    {
+        failed = false;
+        error = nullptr;
+        std::vector<std::thread> threads;
+        start(threads, std::index_sequence_for<Ts...>{});
+        for (auto& t: threads) { t.join(); }
+        if (error) { std::rethrow_exception(error); }
+    }
+
+private:
+    // outboxes<I>[k] is the queue from stage I to stage k (only allocated when k depends on I).
+    template <std::size_t... Is>
+    void make_queues(std::index_sequence<Is...>)
+    {
+        (make_queues_of<Is>(), ...);
+    }
+
+    template <std::size_t I>
+    void make_queues_of()
+    {
+        for (std::size_t k{0}; k < N; ++k)
+        {
+            if (depends[k][I]) { std::get<I>(outboxes)[k] = std::make_unique<queue_t<get_type<I>>>(); }
+        }
+    }
+
+    template <std::size_t I>
+    using get_type = std::tuple_element_t<I, std::tuple<Ts...>>;
+
+    template <std::size_t... Is>
+    void start(std::vector<std::thread>& threads, std::index_sequence<Is...>)
+    {
+        (threads.emplace_back([this]() { stage_loop<Is>(); }), ...);
+    }
+
+    template <std::size_t I>
+    void broadcast(message_t<get_type<I>> const& m)
+    {
+        for (auto& q: std::get<I>(outboxes))
+        {
+            if (q) { q->push(m); }
+        }
+    }
+
+    template <std::size_t I>
+    void stage_loop()
+    {
+        using T = get_type<I>;
+        T& stage = std::get<I>(stages);
+
+        if constexpr (std::tuple_size_v<typename T::depends_on> == 0)
+        {
+            try
+            {
+                while (!failed.load())
+                {
+                    auto batch = stage.produce();
+                    if (!batch) { break; }
+                    broadcast<I>(std::make_shared<typename T::output const>(std::move(*batch)));
+                }
+            }
+            catch (...)
+            {
+                fail(std::current_exception());
+            }
+            broadcast<I>(nullptr);
+        }
+        else
+        {
+            consume_loop<I>(stage, static_cast<typename T::depends_on*>(nullptr));
+        }
+    }
+
+    template <std::size_t I, typename T, typename... Ds>
+    void consume_loop(T& stage, std::tuple<Ds...>*)
+    {
+        // by position and not by type: two inputs may well have the same output type.
+        consume_loop<I, T, Ds...>(stage, std::index_sequence_for<Ds...>{});
+    }
+
+    template <std::size_t I, typename T, typename... Ds, std::size_t... Ks>
+    void consume_loop(T& stage, std::index_sequence<Ks...>)
+    {
+        for (;;)
+        {
+            // one batch from every input. The inputs are zipped: batch k of B1 goes with batch k of B2.
+            std::tuple<message_t<Ds>...> in{inbox<Ds, I>().pop()...};
+
+            bool const ended = ((std::get<Ks>(in) == nullptr) || ...);
+            if (ended)
+            {
+                // If the inputs are not of the same length, drain the longer ones, otherwise their
+                // producers would block forever on a full queue.
+                ((std::get<Ks>(in) ? drain(inbox<Ds, I>()) : void()), ...);
+                if constexpr (has_dependents<I>()) { broadcast<I>(nullptr); }
+                return;
+            }
+
+            try
+            {
+                if constexpr (std::is_void_v<typename T::output>)
+                {
+                    stage.process(*std::get<Ks>(in)...);
+                }
+                else
+                {
+                    auto out = std::make_shared<typename T::output const>(stage.process(*std::get<Ks>(in)...));
+                    if constexpr (has_dependents<I>()) { broadcast<I>(out); }
+                }
+            }
+            catch (...)
+            {
+                // none of the inputs ended yet: drain them all, so the producers don't block on us.
+                fail(std::current_exception());
+                (drain(inbox<Ds, I>()), ...);
+                if constexpr (has_dependents<I>()) { broadcast<I>(nullptr); }
+                return;
+            }
+        }
+    }
+
+    void fail(std::exception_ptr e)
+    {
+        std::lock_guard<std::mutex> lock{error_mutex};
+        if (!error) { error = e; }
+        failed = true;
+    }
+
+    template <typename D, std::size_t I>
+    queue_t<D>& inbox() { return *std::get<index_v<D>>(outboxes)[I]; }
+
+    template <typename Q>
+    static void drain(Q& q) { while (q.pop() != nullptr) {} }
+
+    template <std::size_t I>
+    static constexpr bool has_dependents()
+    {
+        for (std::size_t k{0}; k < N; ++k) { if (depends[k][I]) { return true; } }
+        return false;
+    }
+
+    std::tuple<Ts...> stages;
+    std::tuple<std::array<std::unique_ptr<queue_t<Ts>>, N>...> outboxes;
+
+    std::mutex error_mutex;
+    std::exception_ptr error;
+    std::atomic<bool> failed{false};   // the sources stop producing.
+};
+
+template <typename... Ts>
+using streaming_pipeline_for = streaming_pipeline<topological_order_t<Ts...>>;
+
+
+// ------------------------------------------------------------------------------------------------
+// Stages. Each one sleeps per batch to pretend it works: A1 10ms, B1 and B2 20ms, C1 10ms.
+// One batch costs 60ms end to end, but once the pipeline is full, one comes out every ~20ms.
+// ------------------------------------------------------------------------------------------------
+
+using namespace std::chrono_literals;
+
+using batch_t = std::vector<int>;
+
+struct A1
+{
+    using depends_on = std::tuple<>;
+    using output = batch_t;
+
+    std::optional<batch_t> produce()
+    {
+        if (produced == batches) { return std::nullopt; }
+        std::this_thread::sleep_for(10ms);
+        batch_t b(4);
+        std::iota(b.begin(), b.end(), produced++ * 4);
+        return b;
+    }
+
+    int batches{10};
+    int produced{0};
+};
+
+struct B1
+{
+    using depends_on = std::tuple<A1>;
+    using output = batch_t;
+
+    batch_t process(batch_t const& a)
+    {
+        std::this_thread::sleep_for(20ms);
+        batch_t b{a};
+        for (auto& x: b) { x *= 2; }
+        return b;
+    }
+};
+
+struct B2
+{
+    using depends_on = std::tuple<A1>;
+    using output = batch_t;
+
+    batch_t process(batch_t const& a)
+    {
+        std::this_thread::sleep_for(20ms);
+        batch_t b{a};
+        for (auto& x: b) { x += 1; }
+        return b;
+    }
+};
+
+struct C1
+{
+    using depends_on = std::tuple<B1, B2>;
+    using output = void;
+
+    void process(batch_t const& b1, batch_t const& b2)
+    {
+        std::this_thread::sleep_for(10ms);
+        for (std::size_t i{0}; i < b1.size(); ++i) { sum += b1[i] + b2[i]; }
+        ++batches;
+    }
+
+    long sum{0};
+    int batches{0};
+};
+
+
+// Check throws on the 4th batch; Counter keeps going until the source stops.
+struct Counter
+{
+    using depends_on = std::tuple<>;
+    using output = int;
+
+    std::optional<int> produce() { return (next < 1000) ? std::optional<int>{next++} : std::nullopt; }
+    int next{0};
+};
+
+struct Check
+{
+    using depends_on = std::tuple<Counter>;
+    using output = int;
+
+    int process(int n)
+    {
+        if (n == 3) { throw std::runtime_error{"Check: batch 3 is bad"}; }
+        return n;
+    }
+};
+
+struct Tally
+{
+    using depends_on = std::tuple<Check>;
+    using output = void;
+
+    void process(int) { ++batches; }
+    int batches{0};
+};
+
+
+int main()
+{
+    streaming_pipeline_for<C1> pipeline;
+
+    auto start = std::chrono::steady_clock::now();
+    pipeline.run();
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+    // sum over x in [0, 40) of (2x + x + 1) = 3 * 780 + 40 = 2380.
+    // Sequentially this is 10 x 60ms = 600ms; pipelined it's about 10 x 20ms + the fill time.
+    std::cout << "C1 got " << pipeline.get<C1>().batches << " batches, sum " << pipeline.get<C1>().sum
+              << " in ~" << ms << "ms\n"; // C1 got 10 batches, sum 2380 in ~240ms
+
+    // A stage that throws: the pipeline winds down and run() rethrows.
+    streaming_pipeline_for<Tally> failing;
+    try
+    {
+        failing.run();
+    }
+    catch (std::exception const& e)
+    {
+        std::cout << "error: " << e.what() << ", Tally got " << failing.get<Tally>().batches << " batches\n";
+        // error: Check: batch 3 is bad, Tally got 3 batches
+    }
+}
@@ -0,0 +1,179 @@
+#include <iostream>
+#include <type_traits>
+#include <utility>
+#include <tuple>
+#include <optional>
+#include <variant>
+
+// type_exists tells us *if* a type is in a list; it doesn't tell us *where*.
+// Because of that, detail::create_dep in building_graph.cpp has to scan a vector of variants
+// to find the element of type D.
+//
+// If we know the position of T at compile time, we can store one slot per type and the lookup
+// becomes std::get<index>: a constant offset, no search at all.
+
+template <typename... Args>
+struct types_list {};
+
+
+namespace detail
+{
+
+template <typename T, typename... Others>
+struct index_of;
+
+// Not found. I prefer a readable error over a deep instantiation failure.
+template <typename T>
+struct index_of<T>
+{
+    static_assert(!std::is_same_v<T, T>, "index_of: the type is not in the list");
+};
+
+template <typename T, typename... Others>
+struct index_of<T, T, Others...> : std::integral_constant<std::size_t, 0>
+{
+    // The first match wins, but a slot map with duplicates is a bug. Let's catch it here.
+    static_assert(!(std::is_same_v<T, Others> || ...), "index_of: the type appears more than once");
+};
+
+template <typename T, typename F, typename... Others>
+struct index_of<T, F, Others...> : std::integral_constant<std::size_t, 1 + index_of<T, Others...>::value>
+{
+};
+
+}
+
+
+// index_of works with any type container (types_list, std::tuple, std::variant, ...).
+template <typename T, typename TypeList>
+struct index_of;
+
+template <typename T, template <typename...> typename TypeList, typename... Args>
+struct index_of<T, TypeList<Args...>> : detail::index_of<T, Args...>
+{
+};
+
+template <typename T, typename TypeList>
+static constexpr std::size_t index_of_v = index_of<T, TypeList>::value;
+
+
+// One slot per type. A slot can be empty, because a registry is filled over time.
+template <typename... Ts>
+class type_slot_map
+{
+public:
+    using list_type = types_list<Ts...>;
+
+    template <typename T>
+    static constexpr std::size_t slot_v = index_of_v<T, list_type>;
+
+    template <typename T>
+    bool has() const { return std::get<slot_v<T>>(slots).has_value(); }
+
+    // unchecked access (like operator[] on a vector).
+    template <typename T>
+    T& get() { return *std::get<slot_v<T>>(slots); }
+
+    template <typename T>
+    T const& get() const { return *std::get<slot_v<T>>(slots); }
+
+    template <typename T>
+    T* get_if() { auto& s = std::get<slot_v<T>>(slots); return s ? &*s : nullptr; }
+
+    template <typename T, typename... Args>
+    T& emplace(Args&&... args) { return std::get<slot_v<T>>(slots).emplace(std::forward<Args>(args)...); }
+
+    template <typename T>
+    void reset() { std::get<slot_v<T>>(slots).reset(); }
+
+    // visit the filled slots in type-list order.
+    template <typename F>
+    void for_each(F f)
+    {
+        std::apply([&](auto&... s) { ((s ? f(*s) : void()), ...); }, slots);
+    }
+
+private:
+    std::tuple<std::optional<Ts>...> slots;
+};
+
+
+// The stages from building_graph.cpp.
+struct A1
+{
+   using depends_on = std::tuple<>;
+   friend std::ostream& operator<<(std::ostream& os, A1 const&) { return os << "A1"; }
+};
+
+struct B2
+{
+   using depends_on = std::tuple<A1>;
+   friend std::ostream& operator<<(std::ostream& os, B2 const&) { return os << "B2"; }
+};
+
+struct B1
+{
+   using depends_on = std::tuple<A1, B2>;
+   friend std::ostream& operator<<(std::ostream& os, B1 const&) { return os << "B1"; }
+};
+
+struct C1
+{
+   using depends_on = std::tuple<B1, B2>;
+   friend std::ostream& operator<<(std::ostream& os, C1 const&) { return os << "C1"; }
+};
+
+
+namespace detail
+{
+   template <typename T>
+   struct create
+   {
+      template <typename M>
+      void operator()(M& slots)
+      {
+        // this replaces the linear std::get_if scan of create_dep.
+        if (slots.template has<T>()) { return; }
+        create<typename T::depends_on>{}(slots);
+        std::cout << "creating " << T{} << '\n';
+        slots.template emplace<T>();
+      }
+   };
+
+   template <typename... Ds>
+   struct create<std::tuple<Ds...>>
+   {
+       template <typename M>
+       void operator()(M& slots)
+       {
+            (create<Ds>{}(slots),...);
+       }
+   };
+}
+
+template <typename... Ts>
+auto create_slot_map()
+{
+  type_slot_map<Ts...> slots;
+  (detail::create<Ts>{}(slots), ...);
+  return slots;
+}
+
+
+int main()
+{
+    static_assert(index_of_v<int,    types_list<int, double, char>> == 0);
+    static_assert(index_of_v<char,   std::tuple<int, double, char>> == 2);
+    static_assert(index_of_v<double, std::variant<int, double, char>> == 1);
+    // index_of_v<float, types_list<int, double>>;     // does not compile: not in the list.
+    // index_of_v<int, types_list<int, double, int>>;  // does not compile: duplicate.
+
+    type_slot_map<int, double, char> m;
+    m.emplace<double>(2.5);
+    m.emplace<char>('x');
+    std::cout << m.has<int>() << m.has<double>() << ' ' << m.get<double>() << ' ' << m.get<char>() << '\n'; // 01 2.5 x
+
+    auto slots = create_slot_map<B1, C1, A1, B2>();
+    slots.for_each([](auto const& s) { std::cout << s; });  // B1C1A1B2 (slot order, not creation order)
+    std::cout << '\n';
+}